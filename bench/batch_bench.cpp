@@ -0,0 +1,181 @@
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "multi_renderbatch.h"
+#include "bench.h"
+
+/*
+ * Benchmarks the MultiRenderBatch instance bookkeeping with host storage,
+ * filling a batch with instances spread over several models
+ */
+const size_t NUM_MODELS = 8;
+const size_t INSTANCES_PER_MODEL = 4096;
+const size_t REPS = 20;
+
+using HostBatch = BasicMultiRenderBatch<HostStorage, glm::vec3, glm::mat4>;
+//The same instances placed on a grid with compact transforms
+using GridBatch = BasicMultiRenderBatch<HostStorage, glm::vec3, GridTransform>;
+
+template<typename Batch = HostBatch>
+Batch make_batch(size_t capacity = INSTANCES_PER_MODEL){
+	return bench::make_host_batch<Batch>(std::vector<size_t>(NUM_MODELS, capacity), std::vector<size_t>(NUM_MODELS, 36));
+}
+
+int main(){
+	const size_t total = NUM_MODELS * INSTANCES_PER_MODEL;
+	std::cout << "MultiRenderBatch bookkeeping, " << NUM_MODELS << " models x "
+		<< INSTANCES_PER_MODEL << " instances\n";
+
+	double ms = 0;
+	for (size_t r = 0; r < REPS; ++r){
+		HostBatch batch = make_batch();
+		ms += bench::time_ms(1, [&](){
+			for (size_t i = 0; i < INSTANCES_PER_MODEL; ++i){
+				for (size_t m = 0; m < NUM_MODELS; ++m){
+					batch.push_instance(m, std::make_tuple(glm::vec3{1, 0, 0}, glm::mat4{1}));
+				}
+			}
+			batch.flush();
+		});
+	}
+	bench::report("push_instance interleaved models", ms / REPS, total);
+
+	ms = 0;
+	for (size_t r = 0; r < REPS; ++r){
+		HostBatch batch = make_batch();
+		ms += bench::time_ms(1, [&](){
+			for (size_t m = 0; m < NUM_MODELS; ++m){
+				for (size_t i = 0; i < INSTANCES_PER_MODEL; ++i){
+					batch.push_instance(m, std::make_tuple(glm::vec3{1, 0, 0}, glm::mat4{1}));
+				}
+			}
+			batch.flush();
+		});
+	}
+	bench::report("push_instance model by model", ms / REPS, total);
+
+	//Start each batch with room for one instance so pushing has to grow and repack them
+	ms = 0;
+	for (size_t r = 0; r < REPS; ++r){
+		HostBatch batch = make_batch(1);
+		ms += bench::time_ms(1, [&](){
+			for (size_t i = 0; i < INSTANCES_PER_MODEL; ++i){
+				for (size_t m = 0; m < NUM_MODELS; ++m){
+					batch.push_instance(m, std::make_tuple(glm::vec3{1, 0, 0}, glm::mat4{1}));
+				}
+			}
+			batch.flush();
+		});
+	}
+	bench::report("push_instance growing batches", ms / REPS, total);
+
+	using Instance = std::tuple<glm::vec3, glm::mat4>;
+	const std::vector<Instance> model_instances(INSTANCES_PER_MODEL, std::make_tuple(glm::vec3{1, 0, 0}, glm::mat4{1}));
+	ms = 0;
+	for (size_t r = 0; r < REPS; ++r){
+		HostBatch batch = make_batch();
+		ms += bench::time_ms(1, [&](){
+			for (size_t m = 0; m < NUM_MODELS; ++m){
+				batch.push_instances(m, model_instances.begin(), model_instances.end());
+			}
+			batch.flush();
+		});
+	}
+	bench::report("push_instances per model", ms / REPS, total);
+
+	std::vector<std::pair<size_t, Instance>> mixed_instances;
+	mixed_instances.reserve(total);
+	for (size_t i = 0; i < INSTANCES_PER_MODEL; ++i){
+		for (size_t m = 0; m < NUM_MODELS; ++m){
+			mixed_instances.emplace_back(m, std::make_tuple(glm::vec3{1, 0, 0}, glm::mat4{1}));
+		}
+	}
+	ms = 0;
+	for (size_t r = 0; r < REPS; ++r){
+		HostBatch batch = make_batch();
+		ms += bench::time_ms(1, [&](){
+			batch.push_instances(mixed_instances);
+			batch.flush();
+		});
+	}
+	bench::report("push_instances all models", ms / REPS, total);
+
+	//Remove every instance, striding through the handles so most removals
+	//swap an instance from the end of the batch into the hole
+	ms = 0;
+	for (size_t r = 0; r < REPS; ++r){
+		HostBatch batch = make_batch();
+		const std::vector<HostBatch::InstanceHandle> handles = batch.push_instances(mixed_instances);
+		ms += bench::time_ms(1, [&](){
+			for (size_t s = 0; s < 7; ++s){
+				for (size_t i = s; i < handles.size(); i += 7){
+					batch.remove_instance(handles[i]);
+				}
+			}
+			batch.flush();
+		});
+	}
+	bench::report("remove_instance", ms / REPS, total);
+
+	//Move every other instance each frame, the changes are uploaded by one flush
+	{
+		HostBatch batch = make_batch();
+		const std::vector<HostBatch::InstanceHandle> handles = batch.push_instances(mixed_instances);
+		batch.flush();
+		ms = bench::time_ms(REPS, [&](){
+			for (size_t i = 0; i < handles.size(); i += 2){
+				glm::mat4 m = batch.read<1>(handles[i]);
+				m[3].y += 0.1f;
+				batch.update<1>(handles[i], m);
+			}
+			batch.flush();
+		});
+		bench::report("update<1> half the instances + flush", ms, total / 2);
+		std::cout << "mat4 instance size " << batch.attrib_buf().stride() << " bytes\n";
+	}
+	{
+		GridBatch batch = make_batch<GridBatch>();
+		std::vector<std::pair<size_t, std::tuple<glm::vec3, GridTransform>>> grid_instances;
+		grid_instances.reserve(total);
+		for (const auto &inst : mixed_instances){
+			grid_instances.emplace_back(inst.first, std::make_tuple(glm::vec3{1, 0, 0}, GridTransform{}));
+		}
+		const std::vector<GridBatch::InstanceHandle> handles = batch.push_instances(grid_instances);
+		batch.flush();
+		ms = bench::time_ms(REPS, [&](){
+			for (size_t i = 0; i < handles.size(); i += 2){
+				GridTransform g = batch.read<1>(handles[i]);
+				++g.y;
+				batch.update<1>(handles[i], g);
+			}
+			batch.flush();
+		});
+		bench::report("update<1> half the grid instances + flush", ms, total / 2);
+		std::cout << "GridTransform instance size " << batch.attrib_buf().stride() << " bytes\n";
+	}
+
+	//Sort instances scattered around the origin front to back, alternating between views
+	//from opposite sides so each sort reverses the order
+	{
+		std::mt19937 rng{42};
+		std::uniform_real_distribution<float> pos{-100.f, 100.f};
+		std::vector<std::pair<size_t, Instance>> scattered(mixed_instances);
+		for (auto &inst : scattered){
+			std::get<1>(inst.second) = glm::translate(glm::vec3{pos(rng), 0.f, pos(rng)});
+		}
+		HostBatch batch = make_batch();
+		batch.push_instances(scattered);
+		batch.flush();
+		const glm::mat4 views[2] = {glm::lookAt(glm::vec3{0.f, 10.f, 150.f}, glm::vec3{0.f}, glm::vec3{0.f, 1.f, 0.f}),
+			glm::lookAt(glm::vec3{0.f, 10.f, -150.f}, glm::vec3{0.f}, glm::vec3{0.f, 1.f, 0.f})};
+		size_t v = 0;
+		ms = bench::time_ms(REPS, [&](){
+			batch.sort_front_to_back<1>(views[v]);
+			v = (v + 1) % 2;
+			batch.flush();
+		});
+		bench::report("sort_front_to_back + flush", ms, total);
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "multi_renderbatch.h"
+
+namespace bench {
+/*
+ * Run f reps times and return the average time per run in milliseconds
+ */
+template<typename F>
+double time_ms(size_t reps, F f){
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < reps; ++i){
+		f();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count() / reps;
+}
+/*
+ * Print a result line for a benchmark which processed items items per run
+ */
+inline void report(const std::string &name, double ms, size_t items){
+	std::cout << std::left << std::setw(40) << name << std::right << std::setw(12) << std::fixed
+		<< std::setprecision(4) << ms << " ms" << std::setw(12) << std::setprecision(2)
+		<< ms * 1e6 / items << " ns/item" << std::endl;
+}
+/*
+ * Make a host backed batch with a model for each capacity, model i drawing elems[i]
+ * indices with each model's indices following the previous one's. The benchmarks
+ * never draw so the vertex and index buffers are just sized to fit
+ */
+template<typename Batch>
+Batch make_host_batch(const std::vector<size_t> &capacities, const std::vector<size_t> &elems){
+	std::vector<size_t> elem_offsets(elems.size());
+	size_t total_elems = 0;
+	for (size_t i = 0; i < elems.size(); ++i){
+		elem_offsets[i] = total_elems;
+		total_elems += elems[i];
+	}
+	return Batch{capacities, elems, elem_offsets,
+		BasicPackedBuffer<HostStorage, glm::vec3, glm::vec3, glm::vec3>{total_elems, GL_ARRAY_BUFFER, GL_STATIC_DRAW},
+		BasicPackedBuffer<HostStorage, GLushort>{total_elems, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW}};
+}
+}
+
+#endif
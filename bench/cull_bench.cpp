@@ -0,0 +1,94 @@
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "frustum.h"
+#include "cpu_cull.h"
+#include "thread_pool.h"
+#include "multi_renderbatch.h"
+#include "bench.h"
+
+/*
+ * Benchmarks CPU frustum culling of 100k instances scattered around the camera on
+ * 1 to N threads, both the SIMD bounds test alone and a batch's full cull which
+ * also compacts the visible instances and writes the draw commands
+ */
+const size_t NUM_INSTANCES = 100000;
+const size_t NUM_MODELS = 8;
+const size_t CHUNK_SIZE = 4096;
+const size_t REPS = 50;
+
+using HostBatch = BasicMultiRenderBatch<HostStorage, glm::vec3, glm::mat4>;
+
+int main(){
+	const Frustum frustum{glm::perspective(glm::radians(75.f), 4.f / 3.f, 1.f, 100.f)
+		* glm::lookAt(glm::vec3{0.f, 4.f, 0.f}, glm::vec3{0.f, 0.f, -10.f}, glm::vec3{0.f, 1.f, 0.f})};
+	const AABB model_box{glm::vec3{-0.5f}, glm::vec3{0.5f}};
+	const std::vector<AABB> model_bounds(NUM_MODELS, model_box);
+
+	std::mt19937 rng{42};
+	std::uniform_real_distribution<float> pos{-150.f, 150.f};
+	std::vector<glm::mat4> transforms(NUM_INSTANCES);
+	BoundsSoA bounds;
+	bounds.resize(NUM_INSTANCES);
+	for (size_t i = 0; i < NUM_INSTANCES; ++i){
+		transforms[i] = glm::translate(glm::vec3{pos(rng), pos(rng) * 0.1f, pos(rng)});
+		bounds.set(i, model_box.transform(transforms[i]));
+	}
+	std::vector<std::pair<size_t, std::tuple<glm::vec3, glm::mat4>>> instances(NUM_INSTANCES);
+	for (size_t i = 0; i < NUM_INSTANCES; ++i){
+		instances[i] = std::make_pair(i % NUM_MODELS, std::make_tuple(glm::vec3{1.f}, transforms[i]));
+	}
+
+	const size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::cout << "CPU frustum culling, " << NUM_INSTANCES << " instances, 1 to "
+		<< max_threads << " threads, times are per 100k instances\n";
+	std::vector<uint32_t> visible(NUM_INSTANCES);
+	const size_t num_chunks = (NUM_INSTANCES + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	//The batch cull tests the same bounds so must find the same number of visible instances
+	size_t bounds_visible = 0;
+	for (size_t threads = 1; threads <= max_threads; ++threads){
+		ThreadPool pool{threads};
+		std::vector<size_t> chunk_visible(num_chunks);
+		const double ms = bench::time_ms(REPS, [&](){
+			pool.run(num_chunks, [&](size_t c){
+				const size_t begin = c * CHUNK_SIZE;
+				const size_t end = std::min(begin + CHUNK_SIZE, NUM_INSTANCES);
+				chunk_visible[c] = cpu_cull::cull_bounds(frustum, bounds, begin, end, &visible[begin]);
+			});
+		});
+		const size_t n_visible = std::accumulate(chunk_visible.begin(), chunk_visible.end(), size_t{0});
+		bounds_visible = n_visible;
+		bench::report("bounds test, " + std::to_string(threads) + " threads", ms * 100000.0 / NUM_INSTANCES,
+			100000);
+		if (threads == 1){
+			std::cout << "\tvisible: " << n_visible << ", culled: " << NUM_INSTANCES - n_visible << "\n";
+		}
+	}
+	for (size_t threads = 1; threads <= max_threads; ++threads){
+		ThreadPool pool{threads};
+		HostBatch batch = bench::make_host_batch<HostBatch>(std::vector<size_t>(NUM_MODELS, NUM_INSTANCES / NUM_MODELS + 1),
+			std::vector<size_t>(NUM_MODELS, 36));
+		batch.push_instances(instances);
+		batch.enable_cpu_culling<1>(pool, model_bounds);
+		const double ms = bench::time_ms(REPS, [&](){
+			batch.cull(frustum);
+		});
+		bench::report("batch cull + compact, " + std::to_string(threads) + " threads",
+			ms * 100000.0 / NUM_INSTANCES, 100000);
+		if (batch.visible_instances() != bounds_visible){
+			std::cerr << "batch cull found " << batch.visible_instances() << " visible instances but the bounds test found "
+				<< bounds_visible << std::endl;
+			return 1;
+		}
+		if (threads == 1){
+			std::cout << "\tvisible: " << batch.visible_instances() << ", culled: "
+				<< NUM_INSTANCES - batch.visible_instances() << "\n";
+		}
+	}
+	return 0;
+}
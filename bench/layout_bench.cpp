@@ -0,0 +1,99 @@
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include "interleavedbuffer.h"
+#include "std140_array.h"
+#include "bench.h"
+
+/*
+ * Benchmarks writing blocks into host backed interleaved buffers under each layout,
+ * through mapped writes and through the shadow copy with scattered dirty blocks
+ */
+const size_t NUM_BLOCKS = 1 << 16;
+const size_t REPS = 50;
+
+template<Layout L>
+void bench_layout(const std::string &name){
+	using Buffer = HostInterleavedBuffer<L, glm::vec3, glm::mat4, float>;
+	Buffer buf{NUM_BLOCKS, GL_ARRAY_BUFFER, GL_STREAM_DRAW};
+	const auto block = std::make_tuple(glm::vec3{1, 2, 3}, glm::mat4{2}, 4.f);
+
+	double ms = bench::time_ms(REPS, [&](){
+		buf.map(GL_WRITE_ONLY);
+		for (size_t i = 0; i < NUM_BLOCKS; ++i){
+			buf.write(i, block);
+		}
+		buf.unmap();
+	});
+	bench::report(name + " tuple write", ms, NUM_BLOCKS);
+
+	ms = bench::time_ms(REPS, [&](){
+		buf.map(GL_WRITE_ONLY);
+		for (size_t i = 0; i < NUM_BLOCKS; ++i){
+			buf.template write<1>(i) = glm::mat4{3};
+		}
+		buf.unmap();
+	});
+	bench::report(name + " member write", ms, NUM_BLOCKS);
+
+	buf.enable_shadow();
+	std::mt19937 rng{42};
+	std::uniform_int_distribution<size_t> pick{0, NUM_BLOCKS - 1};
+	std::vector<size_t> scattered(NUM_BLOCKS / 64);
+	for (auto &s : scattered){
+		s = pick(rng);
+	}
+	ms = bench::time_ms(REPS, [&](){
+		for (const auto &s : scattered){
+			buf.shadow_write(s, block);
+		}
+		buf.flush_shadow();
+	});
+	bench::report(name + " scattered shadow write", ms, scattered.size());
+}
+
+/*
+ * Compare converting a uniform array element by element with the bulk SIMD conversion
+ */
+template<typename T, size_t N>
+void bench_array(const std::string &name, const T &val){
+	static STD140Array<T, N> array;
+	std::vector<T> src(N, val), dst(N);
+	double ms = bench::time_ms(REPS * 20, [&](){
+		for (size_t i = 0; i < N; ++i){
+			array.write(i, src[i]);
+		}
+	});
+	bench::report(name + " write", ms, N);
+	ms = bench::time_ms(REPS * 20, [&](){
+		array.write_range(0, src.data(), N);
+	});
+	bench::report(name + " write_range", ms, N);
+	ms = bench::time_ms(REPS * 20, [&](){
+		for (size_t i = 0; i < N; ++i){
+			dst[i] = array.read(i);
+		}
+	});
+	bench::report(name + " read", ms, N);
+	ms = bench::time_ms(REPS * 20, [&](){
+		array.read_range(0, dst.data(), N);
+	});
+	bench::report(name + " read_range", ms, N);
+	//Keep the reads from being optimized out
+	volatile char sink = *reinterpret_cast<const char*>(&dst.back());
+	(void)sink;
+}
+
+int main(){
+	std::cout << "Layout writes, " << NUM_BLOCKS << " blocks of {vec3, mat4, float}\n";
+	bench_layout<Layout::PACKED>("packed");
+	bench_layout<Layout::STD140>("std140");
+	bench_layout<Layout::STD430>("std430");
+
+	std::cout << "\nSTD140 array conversion\n";
+	bench_array<glm::mat3, 1024>("mat3[1024]", glm::mat3{2});
+	bench_array<glm::mat2, 1024>("mat2[1024]", glm::mat2{2});
+	bench_array<glm::vec3, 4096>("vec3[4096]", glm::vec3{1, 2, 3});
+	bench_array<float, 4096>("float[4096]", 1.f);
+	return 0;
+}
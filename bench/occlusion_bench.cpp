@@ -0,0 +1,154 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include "frustum.h"
+#include "thread_pool.h"
+#include "occlusion_buffer.h"
+#include "multi_renderbatch.h"
+#include "bench.h"
+
+/*
+ * Benchmarks software occlusion culling on generated levels of small tiles hidden
+ * among big tiles, which are drawn into the occlusion buffer with a box proxy.
+ * Reports the time to rasterize the occluders and to cull the batch with and without
+ * occlusion on 1 to N threads, and how many of the instances in the frustum were occluded
+ */
+const size_t BUFFER_WIDTH = 256;
+const size_t BUFFER_HEIGHT = 192;
+const size_t REPS = 50;
+//Models 0 and 1 are small tiles and model 2 the big tile, matching the demo's models
+const size_t BIG_TILE = 2;
+
+using HostBatch = BasicMultiRenderBatch<HostStorage, glm::vec3, glm::mat4>;
+using Instance = std::pair<size_t, std::tuple<glm::vec3, glm::mat4>>;
+
+struct Level {
+	std::string name;
+	std::vector<Instance> instances;
+};
+
+Instance small_tile(std::mt19937 &rng, const glm::vec3 &pos){
+	return Instance{rng() % 2, std::make_tuple(glm::vec3{1.f}, glm::translate(pos))};
+}
+Instance big_tile(const glm::mat4 &transform){
+	return Instance{BIG_TILE, std::make_tuple(glm::vec3{0.5f}, transform)};
+}
+/*
+ * Small tiles scattered over a field with rows of walls made of big tiles across it,
+ * with some tiles missing from the walls to see through
+ */
+Level make_walls(std::mt19937 &rng){
+	Level level{"walls", {}};
+	for (float z = -12.f; z > -100.f; z -= 20.f){
+		for (float x = -80.f; x <= 80.f; x += 4.f){
+			for (float y = 0.f; y < 12.f; y += 4.f){
+				if (rng() % 4 == 0){
+					continue;
+				}
+				level.instances.push_back(big_tile(glm::translate(glm::vec3{x, y, z})
+					* glm::rotate(glm::radians(90.f), glm::vec3{1.f, 0.f, 0.f})));
+			}
+		}
+	}
+	std::uniform_real_distribution<float> x{-80.f, 80.f}, z{-100.f, -14.f}, y{0.f, 6.f};
+	for (size_t i = 0; i < 50000; ++i){
+		level.instances.push_back(small_tile(rng, glm::vec3{x(rng), y(rng), z(rng)}));
+	}
+	return level;
+}
+/*
+ * A grid of towers of stacked big tiles with small tiles scattered on the streets between
+ */
+Level make_city(std::mt19937 &rng){
+	Level level{"city", {}};
+	std::uniform_int_distribution<int> floors{2, 8};
+	for (float z = -8.f; z > -100.f; z -= 10.f){
+		for (float x = -80.f; x <= 80.f; x += 10.f){
+			const int n = floors(rng);
+			for (int f = 0; f < n; ++f){
+				level.instances.push_back(big_tile(glm::translate(glm::vec3{x, 2.f * f, z})));
+			}
+		}
+	}
+	std::uniform_real_distribution<float> x{-85.f, 85.f}, z{-100.f, -3.f};
+	for (size_t i = 0; i < 50000; ++i){
+		level.instances.push_back(small_tile(rng, glm::vec3{x(rng), 0.f, z(rng)}));
+	}
+	return level;
+}
+/*
+ * Just the small tiles with nothing to hide them, showing the cost when nothing is occluded
+ */
+Level make_field(std::mt19937 &rng){
+	Level level{"open field", {}};
+	std::uniform_real_distribution<float> x{-80.f, 80.f}, z{-100.f, -3.f};
+	for (size_t i = 0; i < 50000; ++i){
+		level.instances.push_back(small_tile(rng, glm::vec3{x(rng), 0.f, z(rng)}));
+	}
+	return level;
+}
+
+int main(){
+	const glm::mat4 view_proj = glm::perspective(glm::radians(75.f), 4.f / 3.f, 1.f, 100.f)
+		* glm::lookAt(glm::vec3{0.f, 3.f, 0.f}, glm::vec3{0.f, 2.f, -10.f}, glm::vec3{0.f, 1.f, 0.f});
+	const Frustum frustum{view_proj};
+	const AABB small_box{glm::vec3{-1.f}, glm::vec3{1.f}};
+	const std::vector<AABB> model_bounds{small_box, small_box, AABB{glm::vec3{-2.f, -1.f, -2.f}, glm::vec3{2.f, 1.6f, 2.f}}};
+	const OccluderMesh proxy = OccluderMesh::box(AABB{glm::vec3{-2.f, -1.f, -2.f}, glm::vec3{2.f, 0.5f, 2.f}});
+
+	std::mt19937 rng{42};
+	const std::vector<Level> levels{make_walls(rng), make_city(rng), make_field(rng)};
+	const size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::cout << "Software occlusion culling, " << BUFFER_WIDTH << "x" << BUFFER_HEIGHT
+		<< " buffer, 1 to " << max_threads << " threads\n";
+	OcclusionBuffer occlusion{BUFFER_WIDTH, BUFFER_HEIGHT};
+	for (const auto &level : levels){
+		std::cout << level.name << ": " << level.instances.size() << " instances\n";
+		for (size_t threads = 1; threads <= max_threads; ++threads){
+			ThreadPool pool{threads};
+			HostBatch batch = bench::make_host_batch<HostBatch>({1024, 1024, 256}, {66, 66, 258});
+			batch.push_instances(level.instances);
+			batch.enable_cpu_culling<1>(pool, model_bounds);
+			const double frustum_ms = bench::time_ms(REPS, [&](){
+				batch.cull(frustum);
+			});
+			const size_t in_frustum = batch.visible_instances();
+
+			const double raster_ms = bench::time_ms(REPS, [&](){
+				occlusion.begin(view_proj);
+				batch.add_occluders<1>(occlusion, BIG_TILE, proxy);
+				occlusion.rasterize(pool);
+			});
+			batch.set_software_occlusion(&occlusion);
+			const double occlusion_ms = bench::time_ms(REPS, [&](){
+				batch.cull(frustum);
+			});
+			const size_t visible = batch.visible_instances();
+			//Occlusion can only remove instances, and with no occluders drawn, as in the open
+			//field, it must not remove any
+			if (visible > in_frustum || (occlusion.occluder_triangles() == 0 && visible != in_frustum)){
+				std::cerr << level.name << ": " << visible << " instances visible of " << in_frustum
+					<< " in the frustum with " << occlusion.occluder_triangles() << " occluder triangles" << std::endl;
+				return 1;
+			}
+
+			const std::string t = ", " + std::to_string(threads) + " threads";
+			bench::report("  frustum cull" + t, frustum_ms, level.instances.size());
+			if (occlusion.occluder_triangles() > 0){
+				bench::report("  rasterize occluders" + t, raster_ms, occlusion.occluder_triangles());
+			}
+			bench::report("  frustum + occlusion cull" + t, occlusion_ms, level.instances.size());
+			if (threads == 1){
+				std::cout << "\toccluder triangles: " << occlusion.occluder_triangles()
+					<< ", in frustum: " << in_frustum << ", visible: " << visible << ", occluded: "
+					<< in_frustum - visible << " (" << std::setprecision(1)
+					<< (in_frustum ? 100.0 * (in_frustum - visible) / in_frustum : 0.0) << "%)\n";
+			}
+		}
+	}
+	return 0;
+}
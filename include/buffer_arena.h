@@ -0,0 +1,82 @@
+#ifndef BUFFER_ARENA_H
+#define BUFFER_ARENA_H
+
+#include <vector>
+#include <map>
+#include "gl_core_4_4.h"
+
+/*
+ * A range of bytes handed out by a BufferArena, the range lives in
+ * buffer starting at offset. page is used by the arena to find
+ * the buffer the range came from when it's released
+ */
+struct ArenaRange {
+	GLuint buffer;
+	size_t offset, size, page;
+
+	ArenaRange() : buffer(0), offset(0), size(0), page(0){}
+};
+
+/*
+ * A sub-allocating arena that carves large GL buffers (pages) into aligned
+ * ranges so many small InterleavedBuffers can share a few buffer names.
+ * Free space in each page is tracked with a free-list which is coalesced
+ * as ranges are released. Allocations larger than the page size get a page
+ * of their own. The arena must outlive any ranges allocated from it
+ */
+class BufferArena {
+	struct Page {
+		GLuint buffer;
+		size_t size;
+		//Free blocks in the page, offset -> size
+		std::map<size_t, size_t> free_list;
+	};
+	std::vector<Page> pages;
+	size_t page_size, alignment;
+	GLenum usage;
+
+public:
+	/*
+	 * Create an arena which will allocate pages of page_size bytes with the usage hint
+	 * passed. Ranges are aligned to alignment bytes, if 0 the alignment will be the
+	 * strictest of the uniform and shader storage buffer offset alignments so ranges can
+	 * be bound with glBindBufferRange
+	 */
+	BufferArena(size_t page_size, GLenum usage = GL_STATIC_DRAW, size_t alignment = 0);
+	~BufferArena();
+	BufferArena(const BufferArena&) = delete;
+	BufferArena& operator=(const BufferArena&) = delete;
+	/*
+	 * Allocate a range of size bytes from the arena, a new page will be created if no
+	 * existing page has room for it
+	 */
+	ArenaRange alloc(size_t size);
+	/*
+	 * Return a range to the arena, merging it with any free neighbors
+	 */
+	void release(const ArenaRange &range);
+	/*
+	 * Get the number of GL buffers the arena has created
+	 */
+	size_t page_count() const;
+	/*
+	 * Get the total number of bytes currently handed out from the arena
+	 */
+	size_t bytes_used() const;
+	/*
+	 * Get the alignment used for allocated ranges
+	 */
+	size_t range_alignment() const;
+
+private:
+	/*
+	 * Create a new page of at least size bytes and return its index
+	 */
+	size_t add_page(size_t size);
+	/*
+	 * Try to allocate the range from the page, returns false if there isn't room
+	 */
+	bool alloc_from(size_t page, size_t size, ArenaRange &range);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CPU_CULL_H
+#define CPU_CULL_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.h"
+
+/*
+ * World space bounding boxes of a set of instances stored as structure of arrays,
+ * with the center and extent components in their own arrays so the boxes can
+ * be tested against the frustum several at a time with SIMD
+ */
+struct BoundsSoA {
+	std::vector<float> cx, cy, cz, ex, ey, ez;
+
+	size_t size() const;
+	void resize(size_t n);
+	/*
+	 * Set box i to the box passed
+	 */
+	void set(size_t i, const AABB &box);
+	/*
+	 * Copy count boxes starting at src to start at dst, the ranges may overlap
+	 */
+	void move(size_t src, size_t dst, size_t count);
+};
+
+namespace cpu_cull {
+	/*
+	 * Test the boxes [begin, end) against the frustum and write the indices of those
+	 * which may be visible to visible, in increasing order. Returns the number written
+	 */
+	size_t cull_bounds(const Frustum &frustum, const BoundsSoA &bounds, size_t begin, size_t end,
+		uint32_t *visible);
+}
+
+#endif
+
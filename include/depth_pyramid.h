@@ -0,0 +1,60 @@
+#ifndef DEPTH_PYRAMID_H
+#define DEPTH_PYRAMID_H
+
+#include <glm/glm.hpp>
+#include "gl_core_4_4.h"
+
+/*
+ * A hierarchical Z buffer for occlusion culling. Occluders are drawn into the pyramid's
+ * own depth buffer between begin and end, after which each level of the pyramid
+ * is built with the farthest depth of the texels it covers in the level above,
+ * so a box whose nearest depth is beyond the pyramid's depth over its screen
+ * area is hidden. Level 0 of the pyramid is half the size of the depth buffer
+ *
+ * The levels are built by the depth_pyramid compute shader program passed
+ */
+class DepthPyramid {
+	size_t width, height, num_levels;
+	GLuint fbo, depth_tex, pyramid_tex, program;
+	//The view-projection matrix the occluders were drawn with
+	glm::mat4 occluder_view_proj;
+	//The viewport and framebuffer to restore at the end of drawing occluders
+	GLint prev_viewport[4], prev_fbo;
+
+public:
+	/*
+	 * Create a pyramid for occluders drawn at width x height
+	 */
+	DepthPyramid(size_t width, size_t height, GLuint program);
+	~DepthPyramid();
+	DepthPyramid(const DepthPyramid&) = delete;
+	DepthPyramid& operator=(const DepthPyramid&) = delete;
+	/*
+	 * Bind and clear the pyramid's depth buffer to draw occluders seen with the view-projection
+	 * matrix passed. Color writes are disabled until end
+	 */
+	void begin(const glm::mat4 &view_proj);
+	/*
+	 * Restore the previous framebuffer and build the pyramid from the occluders' depth
+	 */
+	void end();
+	/*
+	 * Reset the pyramid to the far plane with an identity view-projection so it hides
+	 * nothing until occluders are drawn. New pyramids start out cleared, clear it again
+	 * before using it if it's gone stale, such as after not being drawn for a while
+	 */
+	void clear();
+	/*
+	 * Get the pyramid texture, a R32F texture with levels() mip levels
+	 */
+	GLuint texture() const;
+	size_t levels() const;
+	/*
+	 * Get the view-projection matrix the occluders were drawn with, boxes must
+	 * be projected with this to be tested against the pyramid
+	 */
+	const glm::mat4& view_proj() const;
+};
+
+#endif
+
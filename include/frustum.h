@@ -0,0 +1,61 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <array>
+#include <glm/glm.hpp>
+
+/*
+ * An axis aligned bounding box, a default constructed box is empty
+ * and will take the bounds of the first point it's expanded by
+ */
+struct AABB {
+	glm::vec3 min, max;
+
+	AABB();
+	AABB(const glm::vec3 &min, const glm::vec3 &max);
+	/*
+	 * Grow the box to contain the point
+	 */
+	void expand(const glm::vec3 &p);
+	bool empty() const;
+	glm::vec3 center() const;
+	/*
+	 * Get the half size of the box along each axis
+	 */
+	glm::vec3 extent() const;
+	/*
+	 * Get the box bounding this box after being transformed by m
+	 */
+	AABB transform(const glm::mat4 &m) const;
+};
+
+/*
+ * A view frustum as the six planes bounding the volume. The planes are extracted from
+ * a view-projection matrix with their normals pointing into the frustum and normalized
+ * so the distance of a point from a plane is in world units. The planes are
+ * stored in the order left, right, bottom, top, near, far
+ */
+class Frustum {
+	std::array<glm::vec4, 6> planes;
+
+public:
+	/*
+	 * Extract the frustum planes in world space from the combined
+	 * projection * view matrix
+	 */
+	Frustum(const glm::mat4 &view_proj);
+	const glm::vec4& plane(size_t i) const;
+	const std::array<glm::vec4, 6>& all_planes() const;
+	/*
+	 * Check if some of the box may be inside the frustum. This is conservative,
+	 * a box near a corner of the frustum may pass even though it's outside
+	 */
+	bool intersects(const AABB &box) const;
+	/*
+	 * Check if the box with the center and extent passed may be inside the frustum
+	 */
+	bool intersects(const glm::vec3 &center, const glm::vec3 &extent) const;
+};
+
+#endif
+
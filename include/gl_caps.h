@@ -0,0 +1,42 @@
+#ifndef GL_CAPS_H
+#define GL_CAPS_H
+
+#include "gl_core_4_4.h"
+
+/*
+ * Checks for optional OpenGL functionality beyond the 4.4 core we load,
+ * these are only valid after ogl_LoadFunctions has been called
+ */
+namespace util {
+	/*
+	 * Check if Direct State Access is available through the ARB_direct_state_access
+	 * extension. The loader only fetches the DSA functions for the extension, so a
+	 * GL 4.5 context that doesn't list it is treated as not having DSA
+	 */
+	inline bool has_dsa(){
+		return ogl_ext_ARB_direct_state_access == ogl_LOAD_SUCCEEDED;
+	}
+	/*
+	 * Check if ARB_indirect_parameters is available to source the number
+	 * of draws in a multi draw indirect from a buffer
+	 */
+	inline bool has_indirect_parameters(){
+		return ogl_ext_ARB_indirect_parameters == ogl_LOAD_SUCCEEDED;
+	}
+	/*
+	 * Check if ARB_pipeline_statistics_query is available to count the work
+	 * done by each pipeline stage, such as fragment shader invocations
+	 */
+	inline bool has_pipeline_statistics(){
+		return ogl_ext_ARB_pipeline_statistics_query == ogl_LOAD_SUCCEEDED;
+	}
+	/*
+	 * Check if ARB_shader_draw_parameters is available to read the base instance
+	 * of a draw in the vertex shader as gl_BaseInstanceARB
+	 */
+	inline bool has_shader_draw_parameters(){
+		return ogl_ext_ARB_shader_draw_parameters == ogl_LOAD_SUCCEEDED;
+	}
+}
+
+#endif
@@ -154,6 +154,10 @@ extern "C" {
 #endif /*__cplusplus*/
 
 extern int ogl_ext_ARB_debug_output;
+extern int ogl_ext_ARB_direct_state_access;
+extern int ogl_ext_ARB_indirect_parameters;
+extern int ogl_ext_ARB_pipeline_statistics_query;
+extern int ogl_ext_ARB_shader_draw_parameters;
 
 #define GL_DEBUG_CALLBACK_FUNCTION_ARB 0x8244
 #define GL_DEBUG_CALLBACK_USER_PARAM_ARB 0x8245
@@ -177,6 +181,18 @@ extern int ogl_ext_ARB_debug_output;
 #define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR_ARB 0x824E
 #define GL_MAX_DEBUG_LOGGED_MESSAGES_ARB 0x9144
 #define GL_MAX_DEBUG_MESSAGE_LENGTH_ARB 0x9143
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+#define GL_PARAMETER_BUFFER_BINDING_ARB 0x80EF
+#define GL_CLIPPING_INPUT_PRIMITIVES_ARB 0x82F6
+#define GL_CLIPPING_OUTPUT_PRIMITIVES_ARB 0x82F7
+#define GL_COMPUTE_SHADER_INVOCATIONS_ARB 0x82F5
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#define GL_GEOMETRY_SHADER_PRIMITIVES_EMITTED_ARB 0x82F3
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#define GL_TESS_CONTROL_SHADER_PATCHES_ARB 0x82F1
+#define GL_TESS_EVALUATION_SHADER_INVOCATIONS_ARB 0x82F2
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#define GL_VERTICES_SUBMITTED_ARB 0x82EE
 
 #define GL_ALPHA 0x1906
 #define GL_ALWAYS 0x0207
@@ -1488,6 +1504,60 @@ extern GLuint (CODEGEN_FUNCPTR *_ptrc_glGetDebugMessageLogARB)(GLuint, GLsizei,
 #define glGetDebugMessageLogARB _ptrc_glGetDebugMessageLogARB
 #endif /*GL_ARB_debug_output*/ 
 
+#ifndef GL_ARB_direct_state_access
+#define GL_ARB_direct_state_access 1
+extern void (CODEGEN_FUNCPTR *_ptrc_glCopyNamedBufferSubData)(GLuint, GLuint, GLintptr, GLintptr, GLsizeiptr);
+#define glCopyNamedBufferSubData _ptrc_glCopyNamedBufferSubData
+extern void (CODEGEN_FUNCPTR *_ptrc_glCreateBuffers)(GLsizei, GLuint *);
+#define glCreateBuffers _ptrc_glCreateBuffers
+extern void (CODEGEN_FUNCPTR *_ptrc_glCreateVertexArrays)(GLsizei, GLuint *);
+#define glCreateVertexArrays _ptrc_glCreateVertexArrays
+extern void (CODEGEN_FUNCPTR *_ptrc_glEnableVertexArrayAttrib)(GLuint, GLuint);
+#define glEnableVertexArrayAttrib _ptrc_glEnableVertexArrayAttrib
+extern void (CODEGEN_FUNCPTR *_ptrc_glFlushMappedNamedBufferRange)(GLuint, GLintptr, GLsizeiptr);
+#define glFlushMappedNamedBufferRange _ptrc_glFlushMappedNamedBufferRange
+extern void (CODEGEN_FUNCPTR *_ptrc_glGetNamedBufferSubData)(GLuint, GLintptr, GLsizeiptr, void *);
+#define glGetNamedBufferSubData _ptrc_glGetNamedBufferSubData
+extern void * (CODEGEN_FUNCPTR *_ptrc_glMapNamedBufferRange)(GLuint, GLintptr, GLsizeiptr, GLbitfield);
+#define glMapNamedBufferRange _ptrc_glMapNamedBufferRange
+extern void (CODEGEN_FUNCPTR *_ptrc_glNamedBufferData)(GLuint, GLsizeiptr, const void *, GLenum);
+#define glNamedBufferData _ptrc_glNamedBufferData
+extern void (CODEGEN_FUNCPTR *_ptrc_glNamedBufferStorage)(GLuint, GLsizeiptr, const void *, GLbitfield);
+#define glNamedBufferStorage _ptrc_glNamedBufferStorage
+extern void (CODEGEN_FUNCPTR *_ptrc_glNamedBufferSubData)(GLuint, GLintptr, GLsizeiptr, const void *);
+#define glNamedBufferSubData _ptrc_glNamedBufferSubData
+extern GLboolean (CODEGEN_FUNCPTR *_ptrc_glUnmapNamedBuffer)(GLuint);
+#define glUnmapNamedBuffer _ptrc_glUnmapNamedBuffer
+extern void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayAttribBinding)(GLuint, GLuint, GLuint);
+#define glVertexArrayAttribBinding _ptrc_glVertexArrayAttribBinding
+extern void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayAttribFormat)(GLuint, GLuint, GLint, GLenum, GLboolean, GLuint);
+#define glVertexArrayAttribFormat _ptrc_glVertexArrayAttribFormat
+extern void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayAttribIFormat)(GLuint, GLuint, GLint, GLenum, GLuint);
+#define glVertexArrayAttribIFormat _ptrc_glVertexArrayAttribIFormat
+extern void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayBindingDivisor)(GLuint, GLuint, GLuint);
+#define glVertexArrayBindingDivisor _ptrc_glVertexArrayBindingDivisor
+extern void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayElementBuffer)(GLuint, GLuint);
+#define glVertexArrayElementBuffer _ptrc_glVertexArrayElementBuffer
+extern void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayVertexBuffer)(GLuint, GLuint, GLuint, GLintptr, GLsizei);
+#define glVertexArrayVertexBuffer _ptrc_glVertexArrayVertexBuffer
+#endif /*GL_ARB_direct_state_access*/ 
+
+#ifndef GL_ARB_indirect_parameters
+#define GL_ARB_indirect_parameters 1
+extern void (CODEGEN_FUNCPTR *_ptrc_glMultiDrawArraysIndirectCountARB)(GLenum, GLintptr, GLintptr, GLsizei, GLsizei);
+#define glMultiDrawArraysIndirectCountARB _ptrc_glMultiDrawArraysIndirectCountARB
+extern void (CODEGEN_FUNCPTR *_ptrc_glMultiDrawElementsIndirectCountARB)(GLenum, GLenum, GLintptr, GLintptr, GLsizei, GLsizei);
+#define glMultiDrawElementsIndirectCountARB _ptrc_glMultiDrawElementsIndirectCountARB
+#endif /*GL_ARB_indirect_parameters*/ 
+
+#ifndef GL_ARB_pipeline_statistics_query
+#define GL_ARB_pipeline_statistics_query 1
+#endif /*GL_ARB_pipeline_statistics_query*/ 
+
+#ifndef GL_ARB_shader_draw_parameters
+#define GL_ARB_shader_draw_parameters 1
+#endif /*GL_ARB_shader_draw_parameters*/ 
+
 extern void (CODEGEN_FUNCPTR *_ptrc_glBlendFunc)(GLenum, GLenum);
 #define glBlendFunc _ptrc_glBlendFunc
 extern void (CODEGEN_FUNCPTR *_ptrc_glClear)(GLbitfield);
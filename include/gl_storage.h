@@ -0,0 +1,201 @@
+#ifndef GL_STORAGE_H
+#define GL_STORAGE_H
+
+#include <array>
+#include <vector>
+#include "gl_core_4_4.h"
+#include "buffer_arena.h"
+#include "staging_pool.h"
+#include "upload_strategy.h"
+#include "gpu_memory.h"
+
+/*
+ * Storage policy for InterleavedBuffer which keeps the data in an OpenGL buffer
+ * object. Works in bytes, the InterleavedBuffer handles the layout of blocks
+ *
+ * The storage can either own its own GL buffer or be backed by a range
+ * sub-allocated from a BufferArena, in which case the data starts at
+ * base_offset() bytes into buf()
+ *
+ * Write-only maps are made following the storage's UploadStrategy and the
+ * time spent in each map is recorded per strategy in map_stats
+ *
+ * When Direct State Access is available buffers are created, mapped and
+ * updated through their names without touching the global binding points.
+ * Buffers which move to a new name when resized then get immutable storage
+ *
+ * Storage owning its own buffer records its memory in the gpu_memory registry under
+ * a category picked from its type, storage in an arena only records reserve copies
+ */
+class GLStorage {
+	size_t bytes;
+	GLuint buffer;
+	GLenum type, access, bound_target;
+	//If we're allowed to change the buffer name when resizing,
+	//letting us save 1 alloc, 1 free and 1 copy
+	bool allow_name_change;
+	//The arena the buffer's storage is allocated from, if any,
+	//and the range of it we're using
+	BufferArena *arena;
+	ArenaRange range;
+	//How write-only maps should avoid synchronizing with the GPU, along with
+	//fences over ranges the GPU may be reading and timing of our maps
+	UploadStrategy strategy;
+	std::vector<RangeFence> fences;
+	std::array<MapStats, NUM_UPLOAD_STRATEGIES> stats;
+	//If we're using DSA and if our storage is immutable (glNamedBufferStorage)
+	bool dsa, immutable;
+	//The staging pool and block we're writing to if mapped through map_staged
+	StagingPool *staging;
+	StagingBlock staged;
+	size_t staged_offset, staged_length;
+	MemCategory category;
+
+public:
+	//The storage lives on the GPU and can be bound and drawn from
+	static constexpr bool device = true;
+
+	/*
+	 * Create storage for bytes bytes in a new buffer of the type passed using the desired
+	 * access flag. If allow_name_change is true the buffer will move to a new name when
+	 * it's resized instead of preserving the old name
+	 */
+	GLStorage(size_t bytes, GLenum type, GLenum access, bool allow_name_change);
+	/*
+	 * Create storage for bytes bytes in a range allocated from the arena
+	 */
+	GLStorage(BufferArena &arena, size_t bytes, GLenum type);
+	~GLStorage();
+	GLStorage(const GLStorage&) = delete;
+	GLStorage& operator=(const GLStorage&) = delete;
+	GLStorage(GLStorage &&s);
+	GLStorage& operator=(GLStorage &&s);
+	GLuint buf() const;
+	/*
+	 * Get the offset in bytes of the start of our data within the buffer,
+	 * this is only non-zero for storage allocated from an arena
+	 */
+	size_t base_offset() const;
+	/*
+	 * Get the size of the storage in bytes
+	 */
+	size_t size() const;
+	/*
+	 * Bind the buffer to the type target specified at creation or to some other target.
+	 * This will not change the stored type of the buffer
+	 */
+	void bind();
+	void bind(GLenum target);
+	/*
+	 * Reset the binding point the buffer is currently bound to
+	 */
+	void unbind();
+	/*
+	 * Bind the whole storage to the indexed target, only our range if we're in an arena
+	 */
+	void bind_base(int index);
+	/*
+	 * Bind the whole storage to the index of some other indexed target
+	 */
+	void bind_base(GLenum target, int index);
+	/*
+	 * Bind length bytes starting at offset to the indexed target
+	 */
+	void bind_range(int index, size_t offset, size_t length);
+	/*
+	 * Map length bytes starting at offset with the flags passed, applying the upload
+	 * strategy to write-only maps. refill is the CPU copy of the whole storage to restore
+	 * the bytes outside the range from if the storage is orphaned, it may be null
+	 */
+	char* map(size_t offset, size_t length, GLbitfield flags, const char *refill);
+	/*
+	 * Map length bytes starting at offset for writing through a block from the staging
+	 * pool, the data is copied over when unmapped
+	 */
+	char* map_staged(StagingPool &pool, size_t offset, size_t length);
+	/*
+	 * Flush length bytes starting at offset bytes into the current mapping
+	 */
+	void flush(size_t offset, size_t length);
+	/*
+	 * Unmap the storage, submitting the staged copy if mapped through map_staged
+	 */
+	void unmap();
+	/*
+	 * Upload length bytes from src to our data starting at offset
+	 */
+	void upload(size_t offset, size_t length, const void *src);
+	/*
+	 * Read length bytes starting at offset back into dst
+	 */
+	void download(size_t offset, size_t length, void *dst);
+	/*
+	 * Copy length bytes within the storage from src_offset to dst_offset, the
+	 * ranges must not overlap
+	 */
+	void copy(size_t src_offset, size_t dst_offset, size_t length);
+	/*
+	 * Grow the storage to new_bytes, preserving the existing data
+	 */
+	void reserve(size_t new_bytes);
+	/*
+	 * Set the strategy used when mapping the storage for writing
+	 */
+	void set_upload_strategy(UploadStrategy s);
+	UploadStrategy upload_strategy() const;
+	/*
+	 * Place a fence after the commands submitted so far which read length bytes
+	 * starting at offset. Only the UNSYNCHRONIZED strategy needs fences, for other
+	 * strategies the driver handles synchronization and this does nothing
+	 */
+	void fence(size_t offset, size_t length);
+	/*
+	 * Get timing information for maps made under the upload strategy
+	 */
+	const MapStats& map_stats(UploadStrategy s) const;
+	void reset_map_stats();
+	/*
+	 * Change the category the storage's memory is recorded under in the registry
+	 */
+	void set_mem_category(MemCategory c);
+	MemCategory mem_category() const;
+
+private:
+	/*
+	 * Orphan the buffer's storage before writing the byte range [offset, offset + length)
+	 * Anything outside the range is refilled from refill. Returns false if the storage
+	 * can't be orphaned without losing data: if we're in an arena or are only writing
+	 * part of the buffer without anything to refill from
+	 */
+	bool orphan(size_t offset, size_t length, const char *refill);
+	/*
+	 * Create a new buffer name, with DSA the buffer object is created immediately
+	 */
+	GLuint create_buffer();
+	/*
+	 * Allocate size bytes of storage for the buffer name b
+	 */
+	void alloc_storage(GLuint b, size_t size);
+	/*
+	 * Copy length bytes from the buffer src starting at src_offset into dst at dst_offset
+	 */
+	void copy_buffer(GLuint src, size_t src_offset, GLuint dst, size_t dst_offset, size_t length);
+	void unmap_buffer();
+	/*
+	 * Block until the GPU is done with any fenced ranges overlapping the
+	 * byte range [start, end)
+	 */
+	void wait_fences(size_t start, size_t end);
+	void clear_fences();
+	/*
+	 * Delete our buffer or return our range to the arena
+	 */
+	void release();
+	/*
+	 * Drop our reference to the buffer, used by the move ctor/assign to remove
+	 * ownership from the old object
+	 */
+	void drop_buffer();
+};
+
+#endif
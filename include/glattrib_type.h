@@ -0,0 +1,120 @@
+#ifndef GLATTRIB_TYPE_H
+#define GLATTRIB_TYPE_H
+
+#include <cstdint>
+#include <type_traits>
+#include <glm/glm.hpp>
+#include "gl_core_4_4.h"
+#include "packed_attribs.h"
+
+/*
+ * Describes how a vertex attribute type is sent through glVertexAttrib*Pointer
+ * or glVertexAttrib*Format. Matrices take a slot (attribute index) per column,
+ * slot_stride bytes apart, each slot reading components values of type.
+ * Integer attributes go through the I variants and are never normalized
+ */
+struct AttribFormat {
+	GLuint slots;
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	bool integer;
+	size_t slot_stride;
+};
+
+namespace detail {
+template<GLuint Slots, GLint Components, GLenum Type, GLboolean Normalized, bool Integer>
+struct AttribTraitsBase {
+	static constexpr GLuint slots = Slots;
+	static constexpr GLint components = Components;
+	static constexpr GLenum type = Type;
+	static constexpr GLboolean normalized = Normalized;
+	static constexpr bool integer = Integer;
+};
+/*
+ * Attribute format of T, types without a specialization can't be sent as attributes
+ */
+template<typename T>
+struct AttribTraits;
+template<>
+struct AttribTraits<float> : AttribTraitsBase<1, 1, GL_FLOAT, GL_FALSE, false> {};
+template<>
+struct AttribTraits<glm::vec2> : AttribTraitsBase<1, 2, GL_FLOAT, GL_FALSE, false> {};
+template<>
+struct AttribTraits<glm::vec3> : AttribTraitsBase<1, 3, GL_FLOAT, GL_FALSE, false> {};
+template<>
+struct AttribTraits<glm::vec4> : AttribTraitsBase<1, 4, GL_FLOAT, GL_FALSE, false> {};
+template<>
+struct AttribTraits<int32_t> : AttribTraitsBase<1, 1, GL_INT, GL_FALSE, true> {};
+template<>
+struct AttribTraits<glm::ivec2> : AttribTraitsBase<1, 2, GL_INT, GL_FALSE, true> {};
+template<>
+struct AttribTraits<glm::ivec3> : AttribTraitsBase<1, 3, GL_INT, GL_FALSE, true> {};
+template<>
+struct AttribTraits<glm::ivec4> : AttribTraitsBase<1, 4, GL_INT, GL_FALSE, true> {};
+template<>
+struct AttribTraits<uint32_t> : AttribTraitsBase<1, 1, GL_UNSIGNED_INT, GL_FALSE, true> {};
+template<>
+struct AttribTraits<glm::uvec2> : AttribTraitsBase<1, 2, GL_UNSIGNED_INT, GL_FALSE, true> {};
+template<>
+struct AttribTraits<glm::uvec3> : AttribTraitsBase<1, 3, GL_UNSIGNED_INT, GL_FALSE, true> {};
+template<>
+struct AttribTraits<glm::uvec4> : AttribTraitsBase<1, 4, GL_UNSIGNED_INT, GL_FALSE, true> {};
+//Matrices are sent a column per slot
+template<>
+struct AttribTraits<glm::mat2> : AttribTraitsBase<2, 2, GL_FLOAT, GL_FALSE, false> {};
+template<>
+struct AttribTraits<glm::mat3> : AttribTraitsBase<3, 3, GL_FLOAT, GL_FALSE, false> {};
+template<>
+struct AttribTraits<glm::mat4> : AttribTraitsBase<4, 4, GL_FLOAT, GL_FALSE, false> {};
+//Packed types from packed_attribs.h
+template<>
+struct AttribTraits<Half2> : AttribTraitsBase<1, 2, GL_HALF_FLOAT, GL_FALSE, false> {};
+template<>
+struct AttribTraits<Half4> : AttribTraitsBase<1, 4, GL_HALF_FLOAT, GL_FALSE, false> {};
+template<>
+struct AttribTraits<UNorm8x4> : AttribTraitsBase<1, 4, GL_UNSIGNED_BYTE, GL_TRUE, false> {};
+template<>
+struct AttribTraits<SNorm16x2> : AttribTraitsBase<1, 2, GL_SHORT, GL_TRUE, false> {};
+template<>
+struct AttribTraits<SNorm16x4> : AttribTraitsBase<1, 4, GL_SHORT, GL_TRUE, false> {};
+template<>
+struct AttribTraits<PackedNormal> : AttribTraitsBase<1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, false> {};
+//Read as an ivec4, the shader masks the sign extended code back to 16 bits
+template<>
+struct AttribTraits<GridTransform> : AttribTraitsBase<1, 4, GL_SHORT, GL_FALSE, true> {};
+
+/*
+ * Check if T has an AttribTraits specialization so can be sent as an attribute
+ */
+template<typename T, typename = void>
+struct HasAttribTraits : std::false_type {};
+template<typename T>
+struct HasAttribTraits<T, decltype(void(AttribTraits<T>::slots))> : std::true_type {};
+/*
+ * Check if all the types passed can be sent as attributes
+ */
+template<typename... T>
+struct AllAttribs : std::true_type {};
+template<typename T, typename... Rest>
+struct AllAttribs<T, Rest...> : std::integral_constant<bool, HasAttribTraits<T>::value && AllAttribs<Rest...>::value> {};
+
+/*
+ * Get the GL type of the components of T
+ */
+template<typename T>
+GLenum gl_attrib_type(){
+	return AttribTraits<T>::type;
+}
+/*
+ * Get the full attribute format for T
+ */
+template<typename T>
+AttribFormat attrib_format(){
+	using A = AttribTraits<T>;
+	return AttribFormat{A::slots, A::components, A::type, A::normalized, A::integer, sizeof(T) / A::slots};
+}
+}
+
+#endif
+
@@ -0,0 +1,75 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <ostream>
+#include "gl_core_4_4.h"
+
+/*
+ * Categories of GPU memory tracked by the registry. Buffers sub-allocated from an
+ * arena don't own GPU memory themselves, the arena's pages are counted under ARENA
+ */
+enum class MemCategory { VERTEX, INDEX, INSTANCE, INDIRECT, UNIFORM, STORAGE, STAGING, ARENA, TEXTURE, OTHER };
+const size_t NUM_MEM_CATEGORIES = 10;
+
+/*
+ * Memory usage of a category. reserve_copies counts how many times a buffer had
+ * to copy its data over to grow and reserve_bytes how much data those copies moved
+ */
+struct MemStats {
+	size_t current, peak, allocs, frees, reserve_copies, reserve_bytes;
+
+	MemStats() : current(0), peak(0), allocs(0), frees(0), reserve_copies(0), reserve_bytes(0){}
+};
+
+/*
+ * A global registry of the GPU memory allocated by the app's buffers and textures,
+ * it's updated by GLStorage, BufferArena, StagingPool and the texture loaders.
+ * Like the GL calls it accompanies the registry should only be used from the GL thread
+ */
+namespace gpu_memory {
+	/*
+	 * Record an allocation or free of bytes of GPU memory in the category
+	 */
+	void track_alloc(MemCategory c, size_t bytes);
+	void track_free(MemCategory c, size_t bytes);
+	/*
+	 * Move bytes of memory that's already been allocated from one category to another
+	 */
+	void retag(MemCategory from, MemCategory to, size_t bytes);
+	/*
+	 * Record that a buffer in the category grew and had to copy bytes of data over
+	 */
+	void track_reserve_copy(MemCategory c, size_t bytes);
+	/*
+	 * Record the texture being allocated with bytes of storage, the texture
+	 * should be released through release_texture when deleted
+	 */
+	void track_texture(GLuint tex, size_t bytes);
+	void release_texture(GLuint tex);
+	/*
+	 * Get the usage for a category
+	 */
+	const MemStats& stats(MemCategory c);
+	/*
+	 * Get the current and peak bytes used across all categories. The total peak is
+	 * tracked separately since the categories don't all peak at the same time
+	 */
+	size_t current_bytes();
+	size_t peak_bytes();
+	/*
+	 * Reset the peaks to the current usage, e.g. after loading
+	 */
+	void reset_peaks();
+	/*
+	 * Get the category buffers bound to a target are assumed to be in by default
+	 */
+	MemCategory category_for_target(GLenum target);
+	const char* category_name(MemCategory c);
+	/*
+	 * Print the usage of each category that's seen any allocations
+	 */
+	void print(std::ostream &os);
+}
+
+#endif
+
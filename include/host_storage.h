@@ -0,0 +1,96 @@
+#ifndef HOST_STORAGE_H
+#define HOST_STORAGE_H
+
+#include <array>
+#include <memory>
+#include "gl_core_4_4.h"
+#include "buffer_arena.h"
+#include "staging_pool.h"
+#include "upload_strategy.h"
+#include "gpu_memory.h"
+
+/*
+ * Storage policy for InterleavedBuffer which keeps the data in aligned host memory
+ * instead of a GL buffer, so the layout and batching code can be run and benchmarked
+ * without a GL context. Maps return pointers straight into the memory, binding and
+ * fencing do nothing and upload strategies are recorded but have no effect.
+ * Host memory isn't recorded in the gpu_memory registry
+ */
+class HostStorage {
+	//Blocks start on a cache line, which also covers the alignment any SIMD loads need
+	static constexpr size_t ALIGNMENT = 64;
+	size_t bytes;
+	std::unique_ptr<char[]> memory;
+	char *data;
+	UploadStrategy strategy;
+	std::array<MapStats, NUM_UPLOAD_STRATEGIES> stats;
+	MemCategory category;
+
+public:
+	//The storage isn't visible to the GPU
+	static constexpr bool device = false;
+
+	/*
+	 * Create storage for bytes bytes, the type and access flags are ignored
+	 * but accepted to match GLStorage
+	 */
+	HostStorage(size_t bytes, GLenum type, GLenum access, bool allow_name_change);
+	/*
+	 * Arenas only hand out GL buffer ranges, so host storage allocated "from" an
+	 * arena just gets its own memory and the arena is never touched
+	 */
+	HostStorage(BufferArena &arena, size_t bytes, GLenum type);
+	HostStorage(const HostStorage&) = delete;
+	HostStorage& operator=(const HostStorage&) = delete;
+	HostStorage(HostStorage &&s);
+	HostStorage& operator=(HostStorage &&s);
+	/*
+	 * There's no GL buffer so the name is always 0
+	 */
+	GLuint buf() const;
+	size_t base_offset() const;
+	size_t size() const;
+	void bind();
+	void bind(GLenum target);
+	void unbind();
+	void bind_base(int index);
+	void bind_base(GLenum target, int index);
+	void bind_range(int index, size_t offset, size_t length);
+	/*
+	 * Get a pointer to length bytes starting at offset, the flags and refill are ignored
+	 */
+	char* map(size_t offset, size_t length, GLbitfield flags, const char *refill);
+	/*
+	 * Host memory needs no staging, the writes go straight into the storage
+	 */
+	char* map_staged(StagingPool &pool, size_t offset, size_t length);
+	void flush(size_t offset, size_t length);
+	void unmap();
+	void upload(size_t offset, size_t length, const void *src);
+	void download(size_t offset, size_t length, void *dst);
+	void copy(size_t src_offset, size_t dst_offset, size_t length);
+	/*
+	 * Grow the storage to new_bytes, preserving the existing data
+	 */
+	void reserve(size_t new_bytes);
+	void set_upload_strategy(UploadStrategy s);
+	UploadStrategy upload_strategy() const;
+	void fence(size_t offset, size_t length);
+	/*
+	 * Get the number of maps made under the upload strategy, the time spent
+	 * mapping host memory isn't worth recording
+	 */
+	const MapStats& map_stats(UploadStrategy s) const;
+	void reset_map_stats();
+	void set_mem_category(MemCategory c);
+	MemCategory mem_category() const;
+
+private:
+	/*
+	 * Allocate size bytes of zeroed memory aligned to ALIGNMENT, with
+	 * the aligned start of the memory returned through ptr
+	 */
+	static std::unique_ptr<char[]> alloc(size_t size, char *&ptr);
+};
+
+#endif
@@ -2,10 +2,17 @@
 #define INTERLEAVED_BUFFER_H
 
 #include <cassert>
+#include <cstring>
+#include <cstdint>
 #include <array>
+#include <vector>
+#include <utility>
+#include <algorithm>
 #include <memory>
 #include <tuple>
 #include "gl_core_4_4.h"
+#include "gl_storage.h"
+#include "host_storage.h"
 #include "sequence.h"
 #include "type_at.h"
 #include "ptr_tuple.h"
@@ -13,7 +20,8 @@
 #include "layout_offset.h"
 
 /*
- * A fixed capacity interleaved buffer stored on the device.
+ * A fixed capacity interleaved buffer stored in some Storage, typically
+ * on the device in a GLStorage.
  * Stores an array of [Args, Args, ...] where Args will be commonly
  * referred to as a block. Layout mode can also be specified and will
  * control the placement of elements within blocks appropriately
@@ -22,22 +30,34 @@
  * them yourself according the std140 rules to match with OpenGL
  * as there isn't much we can do there. For arrays of elements
  * that get padded (scalars, mat2, mat3) use a STD140Array
+ * The same applies for STD430, where STD430Array must be used for
+ * arrays and for mat3 members
+ *
+ * The Storage manages the memory itself in bytes: creating, binding, mapping and
+ * resizing it, while the buffer handles the layout of blocks and the shadow copy.
+ * See GLStorage for buffers in GL buffer objects or arenas and HostStorage for
+ * buffers in host memory that can be used without a GL context
  */
-template<Layout L, typename... Args>
-class InterleavedBuffer {
+template<typename Storage, Layout L, typename... Args>
+class BasicInterleavedBuffer {
 	size_t capacity, stride_;
-	GLuint buffer;
-	GLenum mode, type, access, bound_target;
+	Storage store;
+	GLenum mode;
 	char *data;
 	//Used for tracking where a mapped range begins and ends
 	//if a range isn't mapped end is 0
 	size_t map_start, map_end;
 	std::array<size_t, sizeof...(Args)> offsets;
-	//If we're allowed to change the buffer name when resizing,
-	//letting us save 1 alloc, 1 free and 1 copy
-	bool allow_name_change;
+	//Optional CPU side copy of the buffer and the [start, end) index ranges
+	//of it that have been written since the last flush
+	std::vector<char> shadow;
+	std::vector<std::pair<size_t, size_t>> dirty;
+	bool shadowed;
+	//If more ranges than this are dirty at flush we upload the span
+	//covering them through a single mapping instead of one call per range
+	static constexpr size_t MAX_SUBDATA_UPLOADS = 8;
 
-	using Size = detail::Size<L, Args...>;
+	using Stride = detail::Stride<L, Args...>;
 	using Offset = detail::Offset<L, Args...>;
 
 public:
@@ -51,58 +71,59 @@ public:
 	 * any bindings associated with the buffer. The default is false to make the buffer
 	 * simpler to work with.
 	 */
-	InterleavedBuffer(size_t capacity, GLenum type, GLenum access, bool allow_name_change = false)
-		: capacity(capacity), stride_(Size::size()), buffer(0),
-		mode(0), type(type), access(access), data(nullptr), map_start(0), map_end(0),
-		offsets(Offset::offsets()), allow_name_change(allow_name_change)
-	{
-		glGenBuffers(1, &buffer);
-		glBindBuffer(type, buffer);
-		if (capacity > 0){
-			glBufferData(type, capacity * stride_, NULL, access);
-		}
-	}
-	~InterleavedBuffer(){
-		if (buffer != 0){
-			//If they forgot to unmap the buffer and we're the last one using it
-			if (data != nullptr){
-				bind(bound_target);
-				glUnmapBuffer(type);
-			}
-			glDeleteBuffers(1, &buffer);
+	BasicInterleavedBuffer(size_t capacity, GLenum type, GLenum access, bool allow_name_change = false)
+		: capacity(capacity), stride_(Stride::stride()),
+		store(capacity * Stride::stride(), type, access, allow_name_change),
+		mode(0), data(nullptr), map_start(0), map_end(0), offsets(Offset::offsets()), shadowed(false)
+	{}
+	/*
+	 * Create an interleaved buffer capable of storing capacity blocks of Args
+	 * in a range allocated from the arena. The buffer will be of the type passed
+	 * and will share the GL buffer name with other ranges from the arena. Since
+	 * resizing moves to a new range the buffer name and offset may change on reserve
+	 */
+	BasicInterleavedBuffer(BufferArena &arena, size_t capacity, GLenum type)
+		: capacity(capacity), stride_(Stride::stride()), store(arena, capacity * Stride::stride(), type),
+		mode(0), data(nullptr), map_start(0), map_end(0), offsets(Offset::offsets()), shadowed(false)
+	{}
+	~BasicInterleavedBuffer(){
+		//If they forgot to unmap the buffer and we're the last one using it
+		if (data != nullptr){
+			unmap();
 		}
 	}
-	InterleavedBuffer(const InterleavedBuffer&) = delete;
-	InterleavedBuffer& operator=(const InterleavedBuffer&) = delete;
+	BasicInterleavedBuffer(const BasicInterleavedBuffer&) = delete;
+	BasicInterleavedBuffer& operator=(const BasicInterleavedBuffer&) = delete;
 	/*
 	 * Move the ownership of a buffer into a new object. After moving the previous
 	 * object will no longer hold a valid buffer and should either be re-created or
 	 * no longer used
 	 */
-	InterleavedBuffer(InterleavedBuffer &&b)
-		: capacity(b.capacity), stride_(b.stride_), buffer(b.buffer),
-		mode(b.mode), type(b.type), access(b.access), bound_target(b.bound_target),
+	BasicInterleavedBuffer(BasicInterleavedBuffer &&b)
+		: capacity(b.capacity), stride_(b.stride_), store(std::move(b.store)), mode(b.mode),
 		data(b.data), map_start(b.map_start), map_end(b.map_end), offsets(b.offsets),
-		allow_name_change(b.allow_name_change)
+		shadow(std::move(b.shadow)), dirty(std::move(b.dirty)), shadowed(b.shadowed)
 	{
 		b.drop_buffer();
 	}
-	InterleavedBuffer& operator=(InterleavedBuffer &&b){
+	BasicInterleavedBuffer& operator=(BasicInterleavedBuffer &&b){
 		if (this == &b){
 			return *this;
 		}
+		if (data != nullptr){
+			unmap();
+		}
 		capacity = b.capacity;
 		stride_ = b.stride_;
-		buffer = b.buffer;
+		store = std::move(b.store);
 		mode = b.mode;
-		type = b.type;
-		access = b.access;
-		bound_target = b.bound_target;
 		data = b.data;
 		map_start = b.map_start;
 		map_end = b.map_end;
 		offsets = b.offsets;
-		allow_name_change = b.allow_name_change;
+		shadow = std::move(b.shadow);
+		dirty = std::move(b.dirty);
+		shadowed = b.shadowed;
 		b.drop_buffer();
 		return *this;
 	}
@@ -110,38 +131,61 @@ public:
 	 * Get the buffer id
 	 */
 	GLuint buf(){
-		return buffer;
+		return store.buf();
+	}
+	/*
+	 * Get the offset in bytes of the start of our data within the buffer,
+	 * this is only non-zero for buffers allocated from an arena
+	 */
+	size_t base_offset() const {
+		return store.base_offset();
+	}
+	/*
+	 * Get access to the storage backing the buffer
+	 */
+	Storage& storage(){
+		return store;
 	}
 	/*
 	 * Bind the buffer to the type target specified at creation
 	 */
 	void bind(){
-		assert(buffer != 0);
-		bound_target = type;
-		glBindBuffer(bound_target, buffer);
+		store.bind();
 	}
 	/*
 	 * Bind the buffer to some other type target. This will not change
 	 * the stored type of the buffer, just bind it to some other binding point
 	 */
 	void bind(GLenum target){
-		assert(buffer != 0);
-		bound_target = target;
-		glBindBuffer(bound_target, buffer);
+		store.bind(target);
 	}
 	/*
 	 * Reset the binding point the buffer is currently bound to
 	 */
 	void unbind(){
-		glBindBuffer(bound_target, 0);
+		store.unbind();
 	}
 	/*
 	 * Bind the entire buffer to the desired indexed buffer target
+	 * For buffers allocated from an arena only our range is bound
 	 */
 	void bind_base(int index){
-		assert(buffer != 0);
-		bound_target = type;
-		glBindBufferBase(bound_target, index, buffer);
+		store.bind_base(index);
+	}
+	/*
+	 * Bind the entire buffer to the index of some other indexed target, such as
+	 * binding a vertex buffer as a shader storage buffer. This will not change
+	 * the stored type of the buffer
+	 */
+	void bind_base(GLenum target, int index){
+		store.bind_base(target, index);
+	}
+	/*
+	 * Bind length blocks starting at start to the desired indexed buffer target
+	 */
+	void bind_range(int index, size_t start, size_t length){
+		assert(start + length <= capacity);
+		store.bind_range(index, start * stride_, length * stride_);
 	}
 	/*
 	 * Map the entire buffer for access with the desired mode, m
@@ -149,10 +193,13 @@ public:
 	 * read/write/at
 	 */
 	void map(GLenum m){
-		bind();
 		mode = m;
 		map_start = 0;
-		data = static_cast<char*>(glMapBuffer(bound_target, mode));
+		//Map through the equivalent range map so arena ranges and upload
+		//strategies are handled the same as for map_range
+		GLbitfield flags = m == GL_READ_ONLY ? GL_MAP_READ_BIT
+			: m == GL_WRITE_ONLY ? GL_MAP_WRITE_BIT : GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
+		data = store.map(0, capacity * stride_, flags, shadowed ? shadow.data() : nullptr);
 	}
 	/*
 	 * Map a range of indices of the buffer for access with the desired mode, m
@@ -161,12 +208,23 @@ public:
 	 */
 	void map_range(size_t start, size_t length, int flags){
 		assert(start < capacity && length > 0 && start + length <= capacity);
-		bind();
 		mode = flags;
 		map_start = start;
 		map_end = start + length;
-		data = static_cast<char*>(glMapBufferRange(bound_target, map_start * stride_,
-			length * stride_, flags));
+		data = store.map(map_start * stride_, length * stride_, flags, shadowed ? shadow.data() : nullptr);
+	}
+	/*
+	 * Map a range of indices for writing through a block from the staging pool. The
+	 * writes are copied into the buffer by the GPU when unmapped instead of mapping the
+	 * buffer itself, so a large upload won't stall if the GPU is still reading the buffer.
+	 * Only write access is allowed and the writes bypass any shadow copy
+	 */
+	void map_staged(StagingPool &pool, size_t start, size_t length){
+		assert(start < capacity && length > 0 && start + length <= capacity);
+		mode = GL_MAP_WRITE_BIT;
+		map_start = start;
+		map_end = start + length;
+		data = store.map_staged(pool, start * stride_, length * stride_);
 	}
 	/*
 	 * Flushes a range of the buffer starting at start. The buffer must be bound
@@ -176,18 +234,58 @@ public:
 		assert(data != nullptr);
 		assert(map_end > 0 && map_start <= start && start + length <= map_end
 			&& (mode & GL_MAP_FLUSH_EXPLICIT_BIT));
-		glFlushMappedBufferRange(type, start * stride_, length * stride_);
+		//The flushed offset is relative to the start of the mapped range
+		store.flush((start - map_start) * stride_, length * stride_);
+	}
+	/*
+	 * Set the strategy used when mapping the buffer for writing
+	 */
+	void set_upload_strategy(UploadStrategy s){
+		store.set_upload_strategy(s);
+	}
+	UploadStrategy upload_strategy() const {
+		return store.upload_strategy();
+	}
+	/*
+	 * Place a fence after the commands submitted so far which read length blocks
+	 * starting at start. Only the UNSYNCHRONIZED strategy needs fences, for other
+	 * strategies the driver handles synchronization and this does nothing
+	 */
+	void fence(size_t start, size_t length){
+		assert(start + length <= capacity);
+		store.fence(start * stride_, length * stride_);
+	}
+	/*
+	 * Place a fence over the entire buffer
+	 */
+	void fence(){
+		fence(0, capacity);
+	}
+	/*
+	 * Get timing information for maps made under the upload strategy
+	 */
+	const MapStats& map_stats(UploadStrategy s) const {
+		return store.map_stats(s);
+	}
+	void reset_map_stats(){
+		store.reset_map_stats();
+	}
+	/*
+	 * Set the category the buffer's memory is recorded under in the gpu_memory
+	 * registry, by default this is chosen from the buffer's type
+	 */
+	void set_mem_category(MemCategory c){
+		store.set_mem_category(c);
 	}
 	/*
 	 * Unmap the buffer, it's assumed the buffer was mapped as the type set
 	 * at creation.
 	 */
 	void unmap(){
+		store.unmap();
 		mode = 0;
 		data = nullptr;
 		map_end = 0;
-		bind(bound_target);
-		glUnmapBuffer(type);
 	}
 	/*
 	 * Get a read-only reference to block member I at index i in the array
@@ -271,6 +369,35 @@ public:
 		}
 		write(i, args, typename detail::GenSequence<sizeof...(Args)>::seq{});
 	}
+	/*
+	 * Copy length blocks starting at src to start at dst. The copy is done without
+	 * mapping the buffer and the ranges must not overlap, unless shadowed in which case
+	 * the shadow may hold writes not yet uploaded so the copy is made in the shadow,
+	 * where the ranges may overlap, and the destination marked dirty
+	 */
+	void copy(size_t src, size_t dst, size_t length){
+		assert(data == nullptr && src + length <= capacity && dst + length <= capacity);
+		if (shadowed){
+			std::memmove(shadow.data() + dst * stride_, shadow.data() + src * stride_, length * stride_);
+			mark_dirty(dst, length);
+		}
+		else {
+			store.copy(src * stride_, dst * stride_, length * stride_);
+		}
+	}
+	/*
+	 * Reorder count blocks in the shadow starting at start so block start + k holds the
+	 * block that was at start + order[k], and mark them dirty. order must be a permutation
+	 */
+	void shadow_permute(size_t start, const uint32_t *order, size_t count){
+		assert(shadowed && start + count <= capacity);
+		const std::vector<char> blocks(shadow.begin() + start * stride_, shadow.begin() + (start + count) * stride_);
+		for (size_t k = 0; k < count; ++k){
+			assert(order[k] < count);
+			std::memcpy(shadow.data() + (start + k) * stride_, blocks.data() + order[k] * stride_, stride_);
+		}
+		mark_dirty(start, count);
+	}
 	/*
 	 * Reserve some capacity for the buffer
 	 */
@@ -278,43 +405,138 @@ public:
 		if (new_cap < capacity){
 			return;
 		}
-		//If there's no old data we need to preserve we can just allocate
-		//the new capacity
-		if (capacity == 0){
-			glBindBuffer(type, buffer);
-			glBufferData(type, new_cap * stride_, NULL, access);
+		store.reserve(new_cap * stride_);
+		capacity = new_cap;
+		if (shadowed){
+			shadow.resize(capacity * stride_, 0);
+		}
+	}
+	/*
+	 * Enable the CPU side shadow copy of the buffer. The shadow is filled with
+	 * the current contents of the buffer, after which all writes should go through
+	 * shadow_write so the shadow stays in sync. Written blocks are recorded as dirty
+	 * and uploaded together by the next call to flush_shadow. If the buffer's contents
+	 * don't matter yet pass read_back = false to zero the shadow instead of reading
+	 * the buffer back
+	 */
+	void enable_shadow(bool read_back = true){
+		assert(data == nullptr);
+		if (shadowed){
+			return;
+		}
+		shadowed = true;
+		shadow.resize(capacity * stride_, 0);
+		if (capacity > 0 && read_back){
+			store.download(0, capacity * stride_, shadow.data());
+		}
+	}
+	/*
+	 * Check if the buffer is keeping a CPU side shadow copy
+	 */
+	bool has_shadow() const {
+		return shadowed;
+	}
+	/*
+	 * Read block member I at index i from the shadow copy
+	 */
+	template<size_t I>
+	const typename detail::TypeAt<I, Args...>::type& shadow_read(size_t i) const {
+		assert(shadowed && i < capacity);
+		using T = typename detail::TypeAt<I, Args...>::type;
+		return *reinterpret_cast<const T*>(shadow.data() + offsets[I] + i * stride_);
+	}
+	/*
+	 * Get a reference to block member I at index i in the shadow copy,
+	 * the block is marked dirty and will be uploaded on the next flush
+	 */
+	template<size_t I>
+	typename detail::TypeAt<I, Args...>::type& shadow_write(size_t i){
+		assert(shadowed && i < capacity);
+		using T = typename detail::TypeAt<I, Args...>::type;
+		mark_dirty(i, 1);
+		return *reinterpret_cast<T*>(shadow.data() + offsets[I] + i * stride_);
+	}
+	/*
+	 * Get the raw bytes of block i in the shadow copy, for copying whole blocks
+	 */
+	const char* shadow_block(size_t i) const {
+		assert(shadowed && i < capacity);
+		return shadow.data() + i * stride_;
+	}
+	/*
+	 * Get the raw bytes of block i in the mapped range to copy a whole block into.
+	 * The buffer must be mapped for writing with i in the mapped range
+	 */
+	char* mapped_block(size_t i){
+		assert(data != nullptr && (mode & GL_MAP_WRITE_BIT || mode == GL_WRITE_ONLY || mode == GL_READ_WRITE));
+		assert(map_end == 0 || (i >= map_start && i < map_end));
+		return data + (i - map_start) * stride_;
+	}
+	/*
+	 * Write a block of values to the shadow copy at index i and mark it dirty
+	 */
+	void shadow_write(size_t i, const std::tuple<Args...> &args){
+		assert(shadowed && i < capacity);
+		mark_dirty(i, 1);
+		shadow_write(i, args, typename detail::GenSequence<sizeof...(Args)>::seq{});
+	}
+	/*
+	 * Mark a range of blocks in the shadow copy as needing to be uploaded
+	 */
+	void mark_dirty(size_t start, size_t length){
+		assert(shadowed && start + length <= capacity);
+		//Writes typically walk forward through the buffer so try to extend
+		//the last range before recording a new one
+		if (!dirty.empty() && dirty.back().first <= start && start <= dirty.back().second){
+			dirty.back().second = std::max(dirty.back().second, start + length);
 		}
 		else {
-			GLuint tmp;
-			glGenBuffers(1, &tmp);
-			glBindBuffer(type, tmp);
-			//If we're allowed to change the buffer name then we're moving over
-			//to this new name and should allocate enough room for the new capacity
-			if (allow_name_change){
-				glBufferData(type, new_cap * stride_, NULL, access);
+			dirty.push_back(std::make_pair(start, start + length));
+		}
+	}
+	/*
+	 * Upload the dirty ranges of the shadow copy to the buffer. Overlapping and adjacent
+	 * ranges are merged, if only a few ranges remain they're uploaded with glBufferSubData,
+	 * otherwise the span covering them is written through a single mapping.
+	 * Returns the number of uploads performed
+	 */
+	size_t flush_shadow(){
+		assert(shadowed && data == nullptr);
+		if (dirty.empty()){
+			return 0;
+		}
+		std::sort(dirty.begin(), dirty.end());
+		size_t merged = 0;
+		for (size_t i = 1; i < dirty.size(); ++i){
+			if (dirty[i].first <= dirty[merged].second){
+				dirty[merged].second = std::max(dirty[merged].second, dirty[i].second);
 			}
-			//If we can't change names then just make enough room to save the old data
-			//while we re-alloc the old name
 			else {
-				glBufferData(type, capacity * stride_, NULL, access);
-			}
-			glBindBuffer(GL_COPY_WRITE_BUFFER, tmp);
-			glBindBuffer(GL_COPY_READ_BUFFER, buffer);
-			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity * stride_);
-			if (allow_name_change){
-				glDeleteBuffers(1, &buffer);
-				buffer = tmp;
+				dirty[++merged] = dirty[i];
 			}
-			//If we can't change names now we need to resize the old buffer and move the old data back
-			else {
-				glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
-				glBindBuffer(GL_COPY_READ_BUFFER, tmp);
-				glBufferData(GL_COPY_WRITE_BUFFER, new_cap * stride_, NULL, access);
-				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity * stride_);
-				glDeleteBuffers(1, &tmp);
+		}
+		dirty.resize(merged + 1);
+
+		size_t uploads = 0;
+		if (dirty.size() <= MAX_SUBDATA_UPLOADS){
+			for (const auto &r : dirty){
+				store.upload(r.first * stride_, (r.second - r.first) * stride_,
+					shadow.data() + r.first * stride_);
+				++uploads;
 			}
 		}
-		capacity = new_cap;
+		else {
+			//The shadow mirrors the whole buffer so it's safe to overwrite the clean
+			//blocks between the dirty ranges as well
+			const size_t start = dirty.front().first * stride_;
+			const size_t length = dirty.back().second * stride_ - start;
+			char *dst = store.map(start, length, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT, shadow.data());
+			std::memcpy(dst, shadow.data() + start, length);
+			store.unmap();
+			uploads = 1;
+		}
+		dirty.clear();
+		return uploads;
 	}
 	/*
 	 * Get the number of blocks stored in the buffer
@@ -367,6 +589,20 @@ private:
 	void write(size_t i, const std::tuple<Args...> &args, detail::Sequence<N>){
 		get<N>(i) = std::get<N>(args);
 	}
+	/*
+	 * Recursively write tuple values into the shadow copy of block i
+	 */
+	template<int N, int... S>
+	void shadow_write(size_t i, const std::tuple<Args...> &args, detail::Sequence<N, S...>){
+		using T = typename detail::TypeAt<N, Args...>::type;
+		*reinterpret_cast<T*>(shadow.data() + offsets[N] + i * stride_) = std::get<N>(args);
+		shadow_write(i, args, detail::Sequence<S...>{});
+	}
+	template<int N>
+	void shadow_write(size_t i, const std::tuple<Args...> &args, detail::Sequence<N>){
+		using T = typename detail::TypeAt<N, Args...>::type;
+		*reinterpret_cast<T*>(shadow.data() + offsets[N] + i * stride_) = std::get<N>(args);
+	}
 	/*
 	 * Recursively read values from the block into the tuple using the sequence to
 	 * retrieve the indices
@@ -388,22 +624,30 @@ private:
 	void drop_buffer(){
 		capacity = 0;
 		stride_ = 0;
-		buffer = 0;
 		mode = 0;
-		type = 0;
-		access = 0;
-		bound_target = 0;
 		data = nullptr;
 		map_start = 0;
 		map_end = 0;
 		offsets.fill(0);
+		shadow.clear();
+		dirty.clear();
+		shadowed = false;
 	}
 };
 
+template<Layout L, typename... Args>
+using InterleavedBuffer = BasicInterleavedBuffer<GLStorage, L, Args...>;
+template<Layout L, typename... Args>
+using HostInterleavedBuffer = BasicInterleavedBuffer<HostStorage, L, Args...>;
+
+template<typename Storage, typename... Args>
+using BasicPackedBuffer = BasicInterleavedBuffer<Storage, Layout::PACKED, Args...>;
 template<typename... Args>
 using PackedBuffer = InterleavedBuffer<Layout::PACKED, Args...>;
 template<typename... Args>
 using STD140Buffer = InterleavedBuffer<Layout::STD140, Args...>;
+template<typename... Args>
+using STD430Buffer = InterleavedBuffer<Layout::STD430, Args...>;
 
 #endif
 
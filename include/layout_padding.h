@@ -2,13 +2,14 @@
 #define LAYOUT_PADDING_H
 
 #include "std140_array.h"
+#include "std430_array.h"
 
 /*
  * Padding computes the number of bytes of padding to be placed
  * before some type T in a buffer where the previous object ends
  * at prev
  */
-enum class Layout { PACKED, STD140 };
+enum class Layout { PACKED, STD140, STD430 };
 namespace detail {
 template<Layout L, typename T>
 struct Padding;
@@ -88,6 +89,21 @@ struct Padding<Layout::STD140, glm::mat4> {
 		return padded - prev;
 	}
 };
+/*
+ * STD430 Layout follows the rules described for STD430 buffer
+ * layout, used by shader storage blocks. For full compliance
+ * STD430Arrays must be used instead of regular arrays and mat3
+ */
+template<typename T>
+struct Padding<Layout::STD430, T> {
+	static_assert(!std::is_array<T>::value, "Must use STD430Array for arrays in STD430");
+	static_assert(!std::is_same<T, glm::mat3>::value, "Must use STD430Array for mat3 in STD430");
+	static size_t pad(size_t prev = 0){
+		const size_t align = STD430Alignment<T>::value;
+		size_t padded = prev % align == 0 ? prev : prev + align - prev % align;
+		return padded - prev;
+	}
+};
 }
 
 #endif
@@ -1,8 +1,10 @@
 #ifndef BUFFER_SIZE_H
 #define BUFFER_SIZE_H
 
+#include <algorithm>
 #include <glm/glm.hpp>
 #include "std140_array.h"
+#include "std430_array.h"
 #include "layout_padding.h"
 
 /*
@@ -12,6 +14,8 @@
  * so that they'll follow the layout rules they should be ok though
  * These layout rules are described here:
  * https://www.opengl.org/registry/specs/ARB/uniform_buffer_object.txt
+ * and the STD430 changes to them here:
+ * https://www.opengl.org/registry/specs/ARB/shader_storage_buffer_object.txt
  */
 namespace detail {
 template<Layout L, typename T, typename... Args>
@@ -44,6 +48,41 @@ struct Size<Layout::STD140, STD140Array<T, N>> {
 			+ N * STD140Array<T, N>::stride();
 	}
 };
+template<typename T, size_t N, typename... Args>
+struct Size<Layout::STD430, STD430Array<T, N>, Args...> {
+	static size_t size(size_t prev = 0){
+		//Rule 4 for arrays, without rounding the stride up to vec4
+		size_t sz = Padding<Layout::STD430, STD430Array<T, N>>::pad(prev)
+			+ N * STD430Array<T, N>::stride();
+		return sz +  Size<Layout::STD430, Args...>::size(prev + sz);
+	}
+};
+template<typename T, size_t N>
+struct Size<Layout::STD430, STD430Array<T, N>> {
+	static size_t size(size_t prev = 0){
+		return Padding<Layout::STD430, STD430Array<T, N>>::pad(prev)
+			+ N * STD430Array<T, N>::stride();
+	}
+};
+/*
+ * Compute the stride between consecutive blocks in the buffer. Under STD430
+ * the buffer is read as an array of structs so each block is rounded up
+ * to the largest alignment of its members (rule 9 without rounding to vec4)
+ */
+template<Layout L, typename... Args>
+struct Stride {
+	static size_t stride(){
+		return Size<L, Args...>::size();
+	}
+};
+template<typename... Args>
+struct Stride<Layout::STD430, Args...> {
+	static size_t stride(){
+		const size_t align = std::max({STD430Alignment<Args>::value...});
+		size_t sz = Size<Layout::STD430, Args...>::size();
+		return sz % align == 0 ? sz : sz + align - sz % align;
+	}
+};
 }
 
 #endif
@@ -1,16 +1,28 @@
 #ifndef MULTI_RENDERBATCH_H
 #define MULTI_RENDERBATCH_H
 
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <tuple>
+#include <utility>
 #include <vector>
 #include <algorithm>
+#include <numeric>
+#include <type_traits>
 #include <glm/glm.hpp>
 #include "gl_core_4_4.h"
+#include "gl_caps.h"
 #include "glattrib_type.h"
 #include "interleavedbuffer.h"
-#include "renderbatch.h"
-#include "model.h"
+#include "frustum.h"
+#include "cpu_cull.h"
+#include "thread_pool.h"
+#include "radix_sort.h"
+#include "render_queue.h"
+#include "depth_pyramid.h"
+#include "occlusion_buffer.h"
 
 /*
  * The OpenGL DrawElementsIndirectCommand struct described in the docs
@@ -26,49 +38,364 @@ struct DrawElementsIndirectCommand {
 	{}
 };
 
+/*
+ * How a MultiRenderBatch culls its instances against the view frustum
+ */
+enum class CullMode { NONE, GPU, CPU };
+
+/*
+ * Where the vertex shader reads a MultiRenderBatch's instance data from, either
+ * instanced vertex attributes or a shader storage buffer indexed by the instance
+ */
+enum class InstanceFetch { ATTRIBUTES, STORAGE };
+
+namespace detail {
+/*
+ * The attribute types instances can be culled, sorted and placed as occluders by, giving
+ * their transform matrix and the format code the cull shader decodes them with
+ */
+template<typename T>
+struct InstanceTransform;
+template<>
+struct InstanceTransform<glm::mat4> {
+	static constexpr GLuint format = 0;
+	static const glm::mat4& matrix(const glm::mat4 &m){
+		return m;
+	}
+};
+template<>
+struct InstanceTransform<GridTransform> {
+	static constexpr GLuint format = 1;
+	static glm::mat4 matrix(const GridTransform &g){
+		return g.unpack();
+	}
+};
+}
+
 /*
  * Implements instanced rendering of multiple objects through glMultiDrawElementsIndirect
+ * The VAO separates the attribute formats from the buffers they read, the model vertices
+ * are in vertex buffer binding 0 and the instance attributes in binding 1, so moving to a
+ * new instance buffer only re-points binding 1. When Direct State Access is available
+ * the VAO is set up through its name instead of being bound
+ *
+ * The buffers are kept in the Storage passed, with HostStorage no GL objects are
+ * created so the batch bookkeeping can be run without a GL context. Rendering
+ * and setting attribute indices are only available for device storage
+ *
+ * Instances can optionally be culled against the view frustum, the visible instances
+ * are then compacted into a second attribute buffer with their own draw commands which
+ * are rendered instead. Culling can be done on the GPU by a compute shader, needing no
+ * readback, or on the CPU by testing the instances' bounds with SIMD on a thread pool.
+ * GPU culling can also drop instances hidden behind the occluders in a DepthPyramid,
+ * and CPU culling those hidden behind the occluders in a software OcclusionBuffer
+ *
+ * Instead of vertex attributes the instance data can be read by the vertex shader from
+ * a shader storage buffer at gl_BaseInstanceARB + gl_InstanceID, using no attribute
+ * slots and allowing instance types which can't be sent as attributes
  */
-template<typename... Attribs>
-class MultiRenderBatch {
+template<typename Storage, typename... Attribs>
+class BasicMultiRenderBatch {
+public:
+	/*
+	 * Stable handle to an instance in the batch. Instances move within their batch
+	 * as others are removed but a handle keeps referring to the same instance until
+	 * it's removed, after which the handle may be reused
+	 */
+	using InstanceHandle = size_t;
+	static constexpr InstanceHandle INVALID_INSTANCE = std::numeric_limits<size_t>::max();
+
+private:
+	//The model and index within its batch of the instance a handle refers to
+	struct InstanceRef {
+		size_t model, index;
+	};
+
 	//Sizes of the batches for each model, the number of models we can fit before hitting the next batch's
-	//attributes and offsets in the attributes buffer for each batch
+	//attributes and offsets in the attributes buffer for each batch. Batches grow when they fill up
+	//so the capacities are only a starting point
 	std::vector<size_t> batch_capacities, batch_sizes, batch_offsets;
 	//The models being drawn by the batch packed into a single buffer
-	PackedBuffer<glm::vec3, glm::vec3, glm::vec3> model_vbo;
-	PackedBuffer<GLushort> model_ebo;
-	InterleavedBuffer<Layout::PACKED, Attribs...> attributes;
-	PackedBuffer<DrawElementsIndirectCommand> draw_commands;
+	BasicPackedBuffer<Storage, glm::vec3, glm::vec3, glm::vec3> model_vbo;
+	BasicPackedBuffer<Storage, GLushort> model_ebo;
+	//The attributes and commands are kept shadowed on the CPU, changes to instances are
+	//made in the shadows and uploaded together by flush once per frame
+	BasicPackedBuffer<Storage, Attribs...> attributes;
+	BasicPackedBuffer<Storage, DrawElementsIndirectCommand> draw_commands;
 	std::array<int, sizeof...(Attribs)> indices;
-	GLuint vao;
+	//Handle table mapping handles to their instance, handles not in use have an
+	//INVALID_INSTANCE model and are kept in free_handles to be reused. instance_handles
+	//is the reverse mapping from an instance's attribute index to its handle
+	std::vector<InstanceRef> handle_refs;
+	std::vector<InstanceHandle> free_handles, instance_handles;
+	//The visible instances and draw commands for them written by the cull shader, along
+	//with the model space bounds it tests each model's instances against
+	BasicPackedBuffer<Storage, Attribs...> culled_attributes;
+	BasicPackedBuffer<Storage, DrawElementsIndirectCommand> culled_commands;
+	BasicInterleavedBuffer<Storage, Layout::STD430, glm::vec4, glm::vec4> model_bounds;
+	//With ARB_indirect_parameters the commands of models with visible instances are packed
+	//into compacted_commands on the GPU and the number of them written to draw_count
+	BasicPackedBuffer<Storage, DrawElementsIndirectCommand> compacted_commands;
+	BasicPackedBuffer<Storage, GLuint> draw_count;
+	//For CPU culling the world space bounds of each instance are kept up to date as
+	//instances change, computed from the model space bounds of its model
+	BoundsSoA instance_bounds;
+	std::vector<AABB> cull_model_bounds;
+	std::vector<uint32_t> visible_indices;
+	ThreadPool *cull_pool;
+	//Number of instances and draw commands left by the last CPU cull, the
+	//non-empty commands are packed to the front of culled_commands
+	size_t visible_count, culled_draws;
+	//The occluders GPU and CPU culling test instances against, if any
+	const DepthPyramid *occluders;
+	const OcclusionBuffer *software_occluders;
+	//How instances are fed to the vertex shader and the storage buffer binding they're read from
+	InstanceFetch fetch;
+	GLuint fetch_binding;
+	GLuint vao, cull_program, compact_program;
+	GLint planes_unif, stride_unif, transform_unif, transform_format_unif, hiz_levels_unif, hiz_view_proj_unif;
+	//Offset in bytes of the transform attribute culled by, the InstanceTransform format
+	//of its type and a function decoding it from an instance's attributes
+	size_t transform_offset;
+	GLuint transform_format;
+	glm::mat4 (*read_transform)(const char*);
+	bool dsa;
+	CullMode culling;
 
 public:
 	/*
 	 * Create the multi render batch to handle drawing the models that have been packed into
-	 * the vbo and ebo passed. Also pass in the desired sizes for each batch and offsets
-	 * in the packed models buffer to their elements
+	 * the vbo and ebo passed. Also pass in the initial sizes for each batch and offsets
+	 * in the packed models buffer to their elements. If an arena is passed the attribute
+	 * and draw command buffers will be allocated from it
+	 */
+	BasicMultiRenderBatch(const std::vector<size_t> batch_capacities, const std::vector<size_t> &model_elems,
+		const std::vector<size_t> &model_elem_offsets,
+		BasicPackedBuffer<Storage, glm::vec3, glm::vec3, glm::vec3> &&model_vbo,
+		BasicPackedBuffer<Storage, GLushort> &&model_ebo, BufferArena *arena = nullptr);
+	/*
+	 * Get access to the underlying attributes buffer. The buffer is shadowed so
+	 * any changes must be made through its shadow to not be lost on the next flush
+	 */
+	BasicPackedBuffer<Storage, Attribs...>& attrib_buf();
+	/*
+	 * Push an instance of one of the models to be drawn, returns the instance's handle
+	 * Like all changes to the instances the new instance is uploaded on the next flush
+	 */
+	InstanceHandle push_instance(size_t model, const std::tuple<Attribs...> &a);
+	/*
+	 * Push the instances in [begin, end) of one of the models, It must dereference
+	 * to a std::tuple<Attribs...>. The attributes are written as a single range
+	 * and the model's draw command is updated once. Returns the handles
+	 * of the new instances in the order they were passed
+	 */
+	template<typename It>
+	std::vector<InstanceHandle> push_instances(size_t model, It begin, It end);
+	/*
+	 * Push instances of any of the models, each given as a (model, attributes) pair.
+	 * The instances are grouped by model so each batch is written as a single range
+	 * and each draw command is updated once. Returns the handles of the new instances
+	 * in the order they were passed
+	 */
+	std::vector<InstanceHandle> push_instances(const std::vector<std::pair<size_t, std::tuple<Attribs...>>> &instances);
+	/*
+	 * Remove an instance from the batch. The last instance of the model's batch is
+	 * moved into its place so the batch stays packed, the handle is no longer valid after
 	 */
-	MultiRenderBatch(const std::vector<size_t> batch_capacities, const std::vector<size_t> &model_elems,
-		const std::vector<size_t> &model_elem_offsets, PackedBuffer<glm::vec3, glm::vec3, glm::vec3> &&model_vbo,
-		PackedBuffer<GLushort> &&model_ebo);
+	void remove_instance(InstanceHandle h);
 	/*
-	 * Get access to the underlying attributes buffer
+	 * Make sure the model's batch can hold at least capacity instances, growing
+	 * the attribute buffer and repacking the batches if needed
 	 */
-	InterleavedBuffer<Layout::PACKED, Attribs...>& attrib_buf();
+	void reserve(size_t model, size_t capacity);
 	/*
-	 * Push an instance of one of the models to be drawn
+	 * Get the number of instances of the model the batch can hold before growing
 	 */
-	void push_instance(size_t model, const std::tuple<Attribs...> &a);
+	size_t capacity(size_t model) const;
 	/*
-	 * Set the attribute index to send the attributes too
+	 * Replace all the attributes of an instance
+	 */
+	void update_instance(InstanceHandle h, const std::tuple<Attribs...> &a);
+	/*
+	 * Replace attribute I of an instance
+	 */
+	template<size_t I>
+	void update(InstanceHandle h, const typename detail::TypeAt<I, Attribs...>::type &value);
+	/*
+	 * Read attribute I of an instance
+	 */
+	template<size_t I>
+	const typename detail::TypeAt<I, Attribs...>::type& read(InstanceHandle h) const;
+	/*
+	 * Upload the instances and draw commands changed since the last flush, the
+	 * dirty ranges are merged so a frame's changes go up in a few uploads.
+	 * This is called by render so only needs to be called when not rendering
+	 */
+	void flush();
+	/*
+	 * Check if the handle refers to an instance in the batch
+	 */
+	bool valid(InstanceHandle h) const;
+	/*
+	 * Get the model an instance is of
+	 */
+	size_t instance_model(InstanceHandle h) const;
+	/*
+	 * Get the number of instances of a model in the batch
+	 */
+	size_t instance_count(size_t model) const;
+	/*
+	 * Set the attribute index to send the attributes too. Indices 0, 1 and 2 are taken
+	 * by the models' position, normal and uv. The formats stay valid when the instance
+	 * buffer grows or culling changes the buffer drawn from, so this is only called once
 	 */
 	void set_attrib_indices(const std::array<int, sizeof...(Attribs)> &i);
 	/*
-	 * Render the multi batch
+	 * Choose where the vertex shader reads the instance data from. With STORAGE the instance
+	 * buffer, or the culled buffer when culling, is bound to the shader storage buffer binding
+	 * passed for each draw. The shader reads instance gl_BaseInstanceARB + gl_InstanceID from
+	 * it with a struct matching the packed layout of the attributes, or as words like the cull
+	 * shader does. STORAGE needs ARB_shader_draw_parameters, returns false if it's unavailable
+	 * and the batch keeps using attributes. Attribute indices set before are left enabled
+	 */
+	bool set_instance_fetch(InstanceFetch mode, GLuint binding = 0);
+	InstanceFetch instance_fetch() const;
+	/*
+	 * Enable culling the instances against the view frustum on the GPU with the cull_instances
+	 * compute shader program passed. Attribute I must be the instance's transform, a mat4 or GridTransform, and
+	 * bounds the model space bounds of each model. Once enabled cull must be called each
+	 * frame before rendering. If the compact_commands compute shader program is also passed
+	 * and ARB_indirect_parameters is available the commands of models with no visible instances
+	 * are dropped on the GPU and the number of draws is read from a buffer when rendering
+	 */
+	template<size_t I>
+	void enable_gpu_culling(GLuint program, const std::vector<AABB> &bounds, GLuint compact = 0);
+	/*
+	 * Enable culling the instances against the view frustum on the CPU, testing their
+	 * bounds on the thread pool passed. Attribute I must be the instance's transform, a mat4 or GridTransform, and
+	 * bounds the model space bounds of each model. Once enabled cull must be called each
+	 * frame before rendering
+	 */
+	template<size_t I>
+	void enable_cpu_culling(ThreadPool &pool, const std::vector<AABB> &bounds);
+	/*
+	 * Go back to rendering all instances
+	 */
+	void disable_culling();
+	CullMode cull_mode() const;
+	/*
+	 * Cull the instances against the frustum, the next render will only draw the
+	 * instances which may be visible. Changed instances are uploaded first. GPU culling
+	 * leaves the cull shader program in use, so bind the program to draw with after
+	 */
+	void cull(const Frustum &frustum);
+	/*
+	 * Also cull instances hidden behind the occluders in the depth pyramid when GPU culling,
+	 * pass nullptr to stop. The pyramid should be drawn with a recent view of the scene, such
+	 * as the instances drawn last frame, as its view is what the instances are tested against
+	 */
+	void set_occlusion(const DepthPyramid *pyramid);
+	/*
+	 * Also cull instances hidden behind the occluders in the software occlusion buffer when
+	 * CPU culling, pass nullptr to stop. The buffer must be rasterized before each cull
+	 */
+	void set_software_occlusion(const OcclusionBuffer *buffer);
+	/*
+	 * Add the occluder proxy to the buffer for each instance of the model, transformed
+	 * by the instance's transform attribute I
+	 */
+	template<size_t I>
+	void add_occluders(OcclusionBuffer &buffer, size_t model, const OccluderMesh &proxy) const;
+	/*
+	 * Get the number of instances which passed the last CPU cull. The result of GPU
+	 * culling stays on the GPU so without CPU culling this is all the instances
+	 */
+	size_t visible_instances() const;
+	/*
+	 * Reorder the instances within each model's batch front to back as seen from the view
+	 * matrix passed, by the view depth of their transform attribute I, so early depth
+	 * testing rejects more of the fragments of instances drawn behind others. Depths are
+	 * quantized to 16 bits over each batch's range and radix sorted, handles stay valid.
+	 * CPU culling keeps the order when compacting, GPU culling compacts in whatever order
+	 * the shader invocations run and throws it away, so sorting only pays off when culling
+	 * on the CPU or not culling
+	 */
+	template<size_t I>
+	void sort_front_to_back(const glm::mat4 &view);
+	/*
+	 * Render the multi batch, uploading any changed instances first and fencing the
+	 * attribute and draw command buffers afterwards in case they're using unsynchronized uploads
 	 */
 	void render();
+	/*
+	 * Render only the instances of one model, such as the models that make good occluders.
+	 * When culling only the model's visible instances are drawn
+	 */
+	void render_model(size_t model);
+	/*
+	 * Upload any changed instances and queue drawing the batch with the program and texture
+	 * in the render pass passed, depth orders it among draws sharing its state. The
+	 * batch must stay alive until the queue is flushed
+	 */
+	void submit(RenderQueue &queue, uint32_t pass, GLuint program, const TextureBinding &texture = TextureBinding{},
+		float depth = 0.f);
 
 private:
+	/*
+	 * Issue the draw for the batch with its VAO bound and fence the buffers drawn from
+	 */
+	void draw();
+	/*
+	 * Fence the buffers read by a draw of the batch
+	 */
+	void fence_buffers();
+	/*
+	 * Create the VAO and hook up the model vertices and elements, host storage has no VAO
+	 */
+	void setup_vao(std::true_type);
+	void setup_vao(std::false_type);
+	/*
+	 * Grow the batches so each model's batch can hold at least required[model] instances.
+	 * Batches which must grow get geometric headroom, then the batches are repacked
+	 * into their new regions and the commands' base_instance rewritten in one pass
+	 */
+	void grow(const std::vector<size_t> &required);
+	/*
+	 * Cull by the transform attribute I, which must have an InstanceTransform
+	 */
+	template<size_t I>
+	void set_transform_attrib();
+	template<typename T>
+	static glm::mat4 decode_transform(const char *attribs);
+	/*
+	 * Create the culled buffers and start culling by the transform attribute set
+	 */
+	void setup_culling(CullMode mode);
+	/*
+	 * Run the cull shader, host storage can't be culled on the GPU
+	 */
+	void cull_gpu(const Frustum &frustum, std::true_type);
+	void cull_gpu(const Frustum &frustum, std::false_type);
+	void cull_cpu(const Frustum &frustum);
+	/*
+	 * Update the world space bounds of the model's instance at attribute index i if CPU culling
+	 */
+	void update_bounds(size_t model, size_t i);
+	/*
+	 * Get the buffer the instances are drawn from, which is the culled buffer when culling
+	 */
+	BasicPackedBuffer<Storage, Attribs...>& instance_buffer();
+	/*
+	 * Re-point the VAO's instance buffer binding at the buffer the instances are drawn
+	 * from after it's moved to a new name or range. The attribute formats don't refer
+	 * to the buffer so this is the only call needed
+	 */
+	void rebind_attributes(std::true_type);
+	void rebind_attributes(std::false_type);
+	/*
+	 * Get a handle for the instance at index in the model's batch
+	 */
+	InstanceHandle alloc_handle(size_t model, size_t index);
 	/*
 	 * Recurse through the types in the attribute buffer and set their indices
 	 */
@@ -76,16 +403,41 @@ private:
 	void set_attrib_index();
 	template<typename A, typename B, typename... Args>
 	void set_attrib_index();
+	/*
+	 * Enable and set the format of a single attribute index reading the components
+	 * described by fmt at offset bytes into each instance's attributes in binding 1
+	 */
+	void set_attrib_slot(GLuint slot, const AttribFormat &fmt, size_t offset);
 };
 
-template<typename... Attribs>
-MultiRenderBatch<Attribs...>::MultiRenderBatch(const std::vector<size_t> batch_capacities, const std::vector<size_t> &model_elems,
-	const std::vector<size_t> &model_elem_offsets, PackedBuffer<glm::vec3, glm::vec3, glm::vec3> &&vbo,
-	PackedBuffer<GLushort> &&ebo)
+template<typename Storage, typename... Attribs>
+constexpr typename BasicMultiRenderBatch<Storage, Attribs...>::InstanceHandle
+	BasicMultiRenderBatch<Storage, Attribs...>::INVALID_INSTANCE;
+
+template<typename Storage, typename... Attribs>
+BasicMultiRenderBatch<Storage, Attribs...>::BasicMultiRenderBatch(const std::vector<size_t> batch_capacities,
+	const std::vector<size_t> &model_elems, const std::vector<size_t> &model_elem_offsets,
+	BasicPackedBuffer<Storage, glm::vec3, glm::vec3, glm::vec3> &&vbo, BasicPackedBuffer<Storage, GLushort> &&ebo,
+	BufferArena *arena)
 	: batch_capacities(batch_capacities), batch_sizes(batch_capacities.size(), 0), model_vbo(std::move(vbo)), model_ebo(std::move(ebo)),
-	attributes(std::accumulate(batch_capacities.begin(), batch_capacities.end(), 0), GL_ARRAY_BUFFER, GL_STREAM_DRAW),
-	draw_commands(batch_capacities.size(), GL_DRAW_INDIRECT_BUFFER, GL_STATIC_DRAW)
+	attributes(arena ? BasicPackedBuffer<Storage, Attribs...>{*arena,
+			std::accumulate(batch_capacities.begin(), batch_capacities.end(), size_t{0}), GL_ARRAY_BUFFER}
+		: BasicPackedBuffer<Storage, Attribs...>{std::accumulate(batch_capacities.begin(),
+			batch_capacities.end(), size_t{0}), GL_ARRAY_BUFFER, GL_STREAM_DRAW}),
+	draw_commands(arena ? BasicPackedBuffer<Storage, DrawElementsIndirectCommand>{*arena, batch_capacities.size(),
+			GL_DRAW_INDIRECT_BUFFER}
+		: BasicPackedBuffer<Storage, DrawElementsIndirectCommand>{batch_capacities.size(), GL_DRAW_INDIRECT_BUFFER,
+			GL_STATIC_DRAW}),
+	instance_handles(attributes.size(), INVALID_INSTANCE),
+	culled_attributes(0, GL_ARRAY_BUFFER, GL_STREAM_COPY), culled_commands(0, GL_DRAW_INDIRECT_BUFFER, GL_STREAM_DRAW),
+	model_bounds(0, GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW),
+	compacted_commands(0, GL_DRAW_INDIRECT_BUFFER, GL_STREAM_COPY), draw_count(0, GL_PARAMETER_BUFFER_ARB, GL_STREAM_COPY), cull_pool(nullptr), visible_count(0), culled_draws(0),
+	occluders(nullptr), software_occluders(nullptr),
+	fetch(InstanceFetch::ATTRIBUTES), fetch_binding(0), vao(0), cull_program(0), compact_program(0), planes_unif(-1), stride_unif(-1), transform_unif(-1),
+	transform_format_unif(-1), hiz_levels_unif(-1), hiz_view_proj_unif(-1), transform_offset(0), transform_format(0),
+	read_transform(nullptr), dsa(false), culling(CullMode::NONE)
 {
+	attributes.set_mem_category(MemCategory::INSTANCE);
 	batch_offsets.resize(batch_capacities.size());
 	int cur_offset = 0;
 	for (size_t i = 0; i < batch_offsets.size(); ++i){
@@ -93,106 +445,711 @@ MultiRenderBatch<Attribs...>::MultiRenderBatch(const std::vector<size_t> batch_c
 		cur_offset += batch_capacities[i];
 	}
 
-	//Hook up the model vao using the regular indices I use for position and normal
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-	model_vbo.bind();
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, model_vbo.stride(), 0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, model_vbo.stride(), reinterpret_cast<void*>(model_vbo.offset(1)));
-	model_ebo.bind();
-
-	draw_commands.map(GL_WRITE_ONLY);
+	setup_vao(std::integral_constant<bool, Storage::device>{});
+
+	const size_t first_elem = model_ebo.base_offset() / sizeof(GLushort);
+	attributes.enable_shadow(false);
+	draw_commands.enable_shadow(false);
 	for (size_t i = 0; i < batch_capacities.size(); ++i){
-		draw_commands.write<0>(i) = DrawElementsIndirectCommand{static_cast<GLuint>(model_elems[i]), 0,
-			static_cast<GLuint>(model_elem_offsets[i]), 0, static_cast<GLuint>(batch_offsets[i])};
+		draw_commands.template shadow_write<0>(i) = DrawElementsIndirectCommand{static_cast<GLuint>(model_elems[i]), 0,
+			static_cast<GLuint>(first_elem + model_elem_offsets[i]), 0, static_cast<GLuint>(batch_offsets[i])};
 	}
-	draw_commands.unmap();
+	draw_commands.flush_shadow();
 }
-template<typename... Attribs>
-InterleavedBuffer<Layout::PACKED, Attribs...>& MultiRenderBatch<Attribs...>::attrib_buf(){
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::setup_vao(std::true_type){
+	dsa = util::has_dsa();
+	//Hook up the model vao using the regular indices I use for position, normal and uv
+	//the model buffers may live in an arena so offset by where their data starts. The
+	//uv is stored as a vec3 but only its first two components are used
+	if (dsa){
+		glCreateVertexArrays(1, &vao);
+		glVertexArrayVertexBuffer(vao, 0, model_vbo.buf(), model_vbo.base_offset(), model_vbo.stride());
+		for (GLuint i = 0; i < 3; ++i){
+			glEnableVertexArrayAttrib(vao, i);
+			glVertexArrayAttribFormat(vao, i, i == 2 ? 2 : 3, GL_FLOAT, GL_FALSE, model_vbo.offset(i));
+			glVertexArrayAttribBinding(vao, i, 0);
+		}
+		glVertexArrayBindingDivisor(vao, 1, 1);
+		glVertexArrayElementBuffer(vao, model_ebo.buf());
+	}
+	else {
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glBindVertexBuffer(0, model_vbo.buf(), model_vbo.base_offset(), model_vbo.stride());
+		for (GLuint i = 0; i < 3; ++i){
+			glEnableVertexAttribArray(i);
+			glVertexAttribFormat(i, i == 2 ? 2 : 3, GL_FLOAT, GL_FALSE, model_vbo.offset(i));
+			glVertexAttribBinding(i, 0);
+		}
+		glVertexBindingDivisor(1, 1);
+		model_ebo.bind();
+	}
+	rebind_attributes(std::true_type{});
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::setup_vao(std::false_type){}
+template<typename Storage, typename... Attribs>
+BasicPackedBuffer<Storage, Attribs...>& BasicMultiRenderBatch<Storage, Attribs...>::attrib_buf(){
 	return attributes;
 }
-template<typename... Attribs>
-void MultiRenderBatch<Attribs...>::push_instance(size_t model, const std::tuple<Attribs...> &a){
-	assert(batch_sizes[model] + 1 <= batch_capacities[model]);
+template<typename Storage, typename... Attribs>
+typename BasicMultiRenderBatch<Storage, Attribs...>::InstanceHandle
+BasicMultiRenderBatch<Storage, Attribs...>::push_instance(size_t model, const std::tuple<Attribs...> &a){
+	if (batch_sizes[model] == batch_capacities[model]){
+		std::vector<size_t> required = batch_capacities;
+		required[model] = batch_sizes[model] + 1;
+		grow(required);
+	}
 	//Write the attribute for this new instance of the model and update batch size
-	attributes.map_range(batch_offsets[model] + batch_sizes[model], 1, GL_MAP_WRITE_BIT);
-	attributes.write(batch_offsets[model] + batch_sizes[model], a);
-	attributes.unmap();
+	attributes.shadow_write(batch_offsets[model] + batch_sizes[model], a);
+	update_bounds(model, batch_offsets[model] + batch_sizes[model]);
+	const InstanceHandle h = alloc_handle(model, batch_sizes[model]);
 	++batch_sizes[model];
 
 	//Update our draw command for this batch
-	draw_commands.map_range(model, 1, GL_MAP_WRITE_BIT);
-	auto &cmd = draw_commands.write<0>(model);
-	++cmd.instance_count;
-	draw_commands.unmap();
+	++draw_commands.template shadow_write<0>(model).instance_count;
+	return h;
 }
-template<typename... Attribs>
-void MultiRenderBatch<Attribs...>::set_attrib_indices(const std::array<int, sizeof...(Attribs)> &i){
+template<typename Storage, typename... Attribs>
+template<typename It>
+std::vector<typename BasicMultiRenderBatch<Storage, Attribs...>::InstanceHandle>
+BasicMultiRenderBatch<Storage, Attribs...>::push_instances(size_t model, It begin, It end){
+	const size_t count = std::distance(begin, end);
+	std::vector<InstanceHandle> handles;
+	if (count == 0){
+		return handles;
+	}
+	if (batch_sizes[model] + count > batch_capacities[model]){
+		std::vector<size_t> required = batch_capacities;
+		required[model] = batch_sizes[model] + count;
+		grow(required);
+	}
+	handles.reserve(count);
+	const size_t start = batch_offsets[model] + batch_sizes[model];
+	size_t i = start;
+	for (auto it = begin; it != end; ++it, ++i){
+		attributes.shadow_write(i, *it);
+		update_bounds(model, i);
+		handles.push_back(alloc_handle(model, i - batch_offsets[model]));
+	}
+	batch_sizes[model] += count;
+
+	draw_commands.template shadow_write<0>(model).instance_count += count;
+	return handles;
+}
+template<typename Storage, typename... Attribs>
+std::vector<typename BasicMultiRenderBatch<Storage, Attribs...>::InstanceHandle>
+BasicMultiRenderBatch<Storage, Attribs...>::push_instances(
+	const std::vector<std::pair<size_t, std::tuple<Attribs...>>> &instances)
+{
+	std::vector<InstanceHandle> handles(instances.size(), INVALID_INSTANCE);
+	//Bucket the instances by model with a counting sort so each batch's new
+	//instances are written as one range
+	std::vector<size_t> counts(batch_capacities.size() + 1, 0);
+	for (const auto &inst : instances){
+		assert(inst.first < batch_capacities.size());
+		++counts[inst.first + 1];
+	}
+	std::partial_sum(counts.begin(), counts.end(), counts.begin());
+	std::vector<size_t> order(instances.size());
+	std::vector<size_t> cursor(counts.begin(), counts.end() - 1);
+	for (size_t i = 0; i < instances.size(); ++i){
+		order[cursor[instances[i].first]++] = i;
+	}
+	//Grow all the batches that will overflow together so we only repack once
+	std::vector<size_t> required = batch_capacities;
+	bool overflow = false;
+	for (size_t m = 0; m < batch_capacities.size(); ++m){
+		required[m] = std::max(required[m], batch_sizes[m] + counts[m + 1] - counts[m]);
+		overflow = overflow || required[m] > batch_capacities[m];
+	}
+	if (overflow){
+		grow(required);
+	}
+
+	for (size_t m = 0; m < batch_capacities.size(); ++m){
+		const size_t count = counts[m + 1] - counts[m];
+		if (count == 0){
+			continue;
+		}
+		const size_t start = batch_offsets[m] + batch_sizes[m];
+		for (size_t i = 0; i < count; ++i){
+			const size_t inst = order[counts[m] + i];
+			attributes.shadow_write(start + i, instances[inst].second);
+			update_bounds(m, start + i);
+			handles[inst] = alloc_handle(m, batch_sizes[m] + i);
+		}
+		batch_sizes[m] += count;
+		draw_commands.template shadow_write<0>(m).instance_count += count;
+	}
+	return handles;
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::remove_instance(InstanceHandle h){
+	assert(valid(h));
+	const InstanceRef ref = handle_refs[h];
+	const size_t base = batch_offsets[ref.model];
+	const size_t last = batch_sizes[ref.model] - 1;
+	//Fill the hole with the last instance in the batch and point its handle at the new spot
+	if (ref.index != last){
+		attributes.copy(base + last, base + ref.index, 1);
+		if (culling == CullMode::CPU){
+			instance_bounds.move(base + last, base + ref.index, 1);
+		}
+		const InstanceHandle moved = instance_handles[base + last];
+		instance_handles[base + ref.index] = moved;
+		handle_refs[moved].index = ref.index;
+	}
+	instance_handles[base + last] = INVALID_INSTANCE;
+	--batch_sizes[ref.model];
+
+	--draw_commands.template shadow_write<0>(ref.model).instance_count;
+
+	handle_refs[h].model = INVALID_INSTANCE;
+	free_handles.push_back(h);
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::reserve(size_t model, size_t capacity){
+	if (capacity > batch_capacities[model]){
+		std::vector<size_t> required = batch_capacities;
+		required[model] = capacity;
+		grow(required);
+	}
+}
+template<typename Storage, typename... Attribs>
+size_t BasicMultiRenderBatch<Storage, Attribs...>::capacity(size_t model) const {
+	return batch_capacities[model];
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::update_instance(InstanceHandle h, const std::tuple<Attribs...> &a){
+	assert(valid(h));
+	const size_t i = batch_offsets[handle_refs[h].model] + handle_refs[h].index;
+	attributes.shadow_write(i, a);
+	update_bounds(handle_refs[h].model, i);
+}
+template<typename Storage, typename... Attribs>
+template<size_t I>
+void BasicMultiRenderBatch<Storage, Attribs...>::update(InstanceHandle h,
+	const typename detail::TypeAt<I, Attribs...>::type &value)
+{
+	assert(valid(h));
+	const size_t i = batch_offsets[handle_refs[h].model] + handle_refs[h].index;
+	attributes.template shadow_write<I>(i) = value;
+	if (attributes.offset(I) == transform_offset){
+		update_bounds(handle_refs[h].model, i);
+	}
+}
+template<typename Storage, typename... Attribs>
+template<size_t I>
+const typename detail::TypeAt<I, Attribs...>::type&
+BasicMultiRenderBatch<Storage, Attribs...>::read(InstanceHandle h) const {
+	assert(valid(h));
+	return attributes.template shadow_read<I>(batch_offsets[handle_refs[h].model] + handle_refs[h].index);
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::flush(){
+	attributes.flush_shadow();
+	draw_commands.flush_shadow();
+}
+template<typename Storage, typename... Attribs>
+bool BasicMultiRenderBatch<Storage, Attribs...>::valid(InstanceHandle h) const {
+	return h < handle_refs.size() && handle_refs[h].model != INVALID_INSTANCE;
+}
+template<typename Storage, typename... Attribs>
+size_t BasicMultiRenderBatch<Storage, Attribs...>::instance_model(InstanceHandle h) const {
+	assert(valid(h));
+	return handle_refs[h].model;
+}
+template<typename Storage, typename... Attribs>
+size_t BasicMultiRenderBatch<Storage, Attribs...>::instance_count(size_t model) const {
+	return batch_sizes[model];
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::grow(const std::vector<size_t> &required){
+	std::vector<size_t> new_capacities(batch_capacities.size()), new_offsets(batch_capacities.size());
+	size_t total = 0;
+	for (size_t m = 0; m < batch_capacities.size(); ++m){
+		new_capacities[m] = batch_capacities[m];
+		if (required[m] > batch_capacities[m]){
+			new_capacities[m] = std::max(required[m], 2 * batch_capacities[m]);
+		}
+		new_offsets[m] = total;
+		total += new_capacities[m];
+	}
+	const GLuint old_buf = attributes.buf();
+	const size_t old_base = attributes.base_offset();
+	attributes.reserve(total);
+	instance_handles.resize(total, INVALID_INSTANCE);
+	if (culling == CullMode::CPU){
+		instance_bounds.resize(total);
+		visible_indices.resize(total);
+	}
+
+	//Batches only ever move towards the end of the buffer so moving them back to front
+	//never overwrites a batch that hasn't been moved yet
+	for (size_t m = batch_capacities.size(); m-- > 0;){
+		if (new_offsets[m] == batch_offsets[m]){
+			continue;
+		}
+		if (batch_sizes[m] > 0){
+			attributes.copy(batch_offsets[m], new_offsets[m], batch_sizes[m]);
+			if (culling == CullMode::CPU){
+				instance_bounds.move(batch_offsets[m], new_offsets[m], batch_sizes[m]);
+			}
+			std::copy_backward(instance_handles.begin() + batch_offsets[m],
+				instance_handles.begin() + batch_offsets[m] + batch_sizes[m],
+				instance_handles.begin() + new_offsets[m] + batch_sizes[m]);
+		}
+		//Clear out the handles for the part of the old region the batch no longer covers
+		std::fill(instance_handles.begin() + batch_offsets[m],
+			instance_handles.begin() + std::min(batch_offsets[m] + batch_sizes[m], new_offsets[m]),
+			INVALID_INSTANCE);
+		draw_commands.template shadow_write<0>(m).base_instance = static_cast<GLuint>(new_offsets[m]);
+	}
+	batch_capacities = std::move(new_capacities);
+	batch_offsets = std::move(new_offsets);
+
+	bool moved = attributes.buf() != old_buf || attributes.base_offset() != old_base;
+	//The culled instances are rewritten every cull so there's nothing to preserve
+	if (culling != CullMode::NONE){
+		culled_attributes = BasicPackedBuffer<Storage, Attribs...>{total, GL_ARRAY_BUFFER, GL_STREAM_COPY};
+		culled_attributes.set_mem_category(MemCategory::INSTANCE);
+		moved = true;
+	}
+	if (moved){
+		rebind_attributes(std::integral_constant<bool, Storage::device>{});
+	}
+}
+template<typename Storage, typename... Attribs>
+BasicPackedBuffer<Storage, Attribs...>& BasicMultiRenderBatch<Storage, Attribs...>::instance_buffer(){
+	return culling != CullMode::NONE ? culled_attributes : attributes;
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::rebind_attributes(std::true_type){
+	auto &instances = instance_buffer();
+	if (dsa){
+		glVertexArrayVertexBuffer(vao, 1, instances.buf(), instances.base_offset(), instances.stride());
+	}
+	else {
+		glBindVertexArray(vao);
+		glBindVertexBuffer(1, instances.buf(), instances.base_offset(), instances.stride());
+	}
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::rebind_attributes(std::false_type){}
+template<typename Storage, typename... Attribs>
+typename BasicMultiRenderBatch<Storage, Attribs...>::InstanceHandle
+BasicMultiRenderBatch<Storage, Attribs...>::alloc_handle(size_t model, size_t index){
+	InstanceHandle h;
+	if (!free_handles.empty()){
+		h = free_handles.back();
+		free_handles.pop_back();
+		handle_refs[h] = InstanceRef{model, index};
+	}
+	else {
+		h = handle_refs.size();
+		handle_refs.push_back(InstanceRef{model, index});
+	}
+	instance_handles[batch_offsets[model] + index] = h;
+	return h;
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::set_attrib_indices(const std::array<int, sizeof...(Attribs)> &i){
+	static_assert(detail::AllAttribs<Attribs...>::value,
+		"Instances with types which can't be sent as attributes must be read from storage");
 	indices = i;
-	glBindVertexArray(vao);
-	attributes.bind();
+	if (!dsa){
+		glBindVertexArray(vao);
+	}
 	set_attrib_index<Attribs...>();
 }
-template<typename... Attribs>
-void MultiRenderBatch<Attribs...>::render(){
+template<typename Storage, typename... Attribs>
+bool BasicMultiRenderBatch<Storage, Attribs...>::set_instance_fetch(InstanceFetch mode, GLuint binding){
+	if (mode == InstanceFetch::STORAGE && Storage::device && !util::has_shader_draw_parameters()){
+		return false;
+	}
+	//Instances are read as std430 words
+	assert(mode == InstanceFetch::ATTRIBUTES || attributes.stride() % 4 == 0);
+	fetch = mode;
+	fetch_binding = binding;
+	return true;
+}
+template<typename Storage, typename... Attribs>
+InstanceFetch BasicMultiRenderBatch<Storage, Attribs...>::instance_fetch() const {
+	return fetch;
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::render(){
+	flush();
 	glBindVertexArray(vao);
-	draw_commands.bind();
-	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, NULL, draw_commands.size(),
-		draw_commands.stride());
+	draw();
 }
-template<typename... Attribs>
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::submit(RenderQueue &queue, uint32_t pass, GLuint program,
+	const TextureBinding &texture, float depth)
+{
+	flush();
+	queue.submit(DrawPacket{pass, program, vao, texture, depth, [this](){ draw(); }});
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::draw(){
+	if (fetch == InstanceFetch::STORAGE){
+		instance_buffer().bind_base(GL_SHADER_STORAGE_BUFFER, fetch_binding);
+	}
+	if (culling == CullMode::GPU && compact_program){
+		compacted_commands.bind();
+		draw_count.bind();
+		glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_SHORT, compacted_commands.base_offset(),
+			draw_count.base_offset(), compacted_commands.size(), compacted_commands.stride());
+	}
+	else {
+		auto &commands = culling != CullMode::NONE ? culled_commands : draw_commands;
+		const size_t draws = culling == CullMode::CPU ? culled_draws : commands.size();
+		commands.bind();
+		if (draws > 0){
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+				reinterpret_cast<void*>(commands.base_offset()), draws, commands.stride());
+		}
+	}
+	fence_buffers();
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::render_model(size_t model){
+	assert(model < batch_sizes.size());
+	flush();
+	glBindVertexArray(vao);
+	if (fetch == InstanceFetch::STORAGE){
+		instance_buffer().bind_base(GL_SHADER_STORAGE_BUFFER, fetch_binding);
+	}
+	//GPU culling counts each model's instances into the culled command at its index, CPU
+	//culling packs the commands of models with visible instances so we look for the model's
+	auto &commands = culling != CullMode::NONE ? culled_commands : draw_commands;
+	size_t cmd = model;
+	if (culling == CullMode::CPU){
+		for (cmd = 0; cmd < culled_draws; ++cmd){
+			if (culled_commands.template shadow_read<0>(cmd).base_instance == batch_offsets[model]){
+				break;
+			}
+		}
+		if (cmd == culled_draws){
+			return;
+		}
+	}
+	commands.bind();
+	glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+		reinterpret_cast<void*>(commands.base_offset() + cmd * commands.stride()));
+	fence_buffers();
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::fence_buffers(){
+	attributes.fence();
+	draw_commands.fence();
+	if (culling != CullMode::NONE){
+		culled_attributes.fence();
+		culled_commands.fence();
+	}
+}
+template<typename Storage, typename... Attribs>
+template<size_t I>
+void BasicMultiRenderBatch<Storage, Attribs...>::enable_gpu_culling(GLuint program, const std::vector<AABB> &bounds,
+	GLuint compact)
+{
+	assert(bounds.size() == batch_capacities.size());
+	//The shader copies instances as words
+	assert(attributes.stride() % 4 == 0 && attributes.offset(I) % 4 == 0);
+	cull_program = program;
+	planes_unif = glGetUniformLocation(program, "planes");
+	stride_unif = glGetUniformLocation(program, "instance_stride");
+	transform_unif = glGetUniformLocation(program, "transform_offset");
+	transform_format_unif = glGetUniformLocation(program, "transform_format");
+	hiz_levels_unif = glGetUniformLocation(program, "hiz_levels");
+	hiz_view_proj_unif = glGetUniformLocation(program, "hiz_view_proj");
+
+	model_bounds = BasicInterleavedBuffer<Storage, Layout::STD430, glm::vec4, glm::vec4>{bounds.size(),
+		GL_SHADER_STORAGE_BUFFER, GL_STATIC_DRAW};
+	model_bounds.map(GL_WRITE_ONLY);
+	for (size_t i = 0; i < bounds.size(); ++i){
+		model_bounds.template write<0>(i) = glm::vec4{bounds[i].center(), 1.f};
+		model_bounds.template write<1>(i) = glm::vec4{bounds[i].extent(), 0.f};
+	}
+	model_bounds.unmap();
+	compact_program = util::has_indirect_parameters() ? compact : 0;
+	if (compact_program){
+		compacted_commands = BasicPackedBuffer<Storage, DrawElementsIndirectCommand>{draw_commands.size(),
+			GL_DRAW_INDIRECT_BUFFER, GL_STREAM_COPY};
+		draw_count = BasicPackedBuffer<Storage, GLuint>{1, GL_PARAMETER_BUFFER_ARB, GL_STREAM_COPY};
+	}
+	set_transform_attrib<I>();
+	setup_culling(CullMode::GPU);
+}
+template<typename Storage, typename... Attribs>
+template<size_t I>
+void BasicMultiRenderBatch<Storage, Attribs...>::enable_cpu_culling(ThreadPool &pool, const std::vector<AABB> &bounds){
+	assert(bounds.size() == batch_capacities.size());
+	cull_pool = &pool;
+	cull_model_bounds = bounds;
+	instance_bounds.resize(attributes.size());
+	visible_indices.resize(attributes.size());
+	set_transform_attrib<I>();
+	setup_culling(CullMode::CPU);
+	//Bring the bounds up to date with the instances we already have
+	for (size_t m = 0; m < batch_sizes.size(); ++m){
+		for (size_t i = 0; i < batch_sizes[m]; ++i){
+			update_bounds(m, batch_offsets[m] + i);
+		}
+	}
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::disable_culling(){
+	if (culling != CullMode::NONE){
+		culling = CullMode::NONE;
+		rebind_attributes(std::integral_constant<bool, Storage::device>{});
+	}
+}
+template<typename Storage, typename... Attribs>
+CullMode BasicMultiRenderBatch<Storage, Attribs...>::cull_mode() const {
+	return culling;
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::cull(const Frustum &frustum){
+	assert(culling != CullMode::NONE);
+	flush();
+	if (culling == CullMode::GPU){
+		cull_gpu(frustum, std::integral_constant<bool, Storage::device>{});
+	}
+	else {
+		cull_cpu(frustum);
+	}
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::set_occlusion(const DepthPyramid *pyramid){
+	occluders = pyramid;
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::set_software_occlusion(const OcclusionBuffer *buffer){
+	software_occluders = buffer;
+}
+template<typename Storage, typename... Attribs>
+template<size_t I>
+void BasicMultiRenderBatch<Storage, Attribs...>::add_occluders(OcclusionBuffer &buffer, size_t model,
+	const OccluderMesh &proxy) const
+{
+	using Transform = detail::InstanceTransform<typename detail::TypeAt<I, Attribs...>::type>;
+	for (size_t i = 0; i < batch_sizes[model]; ++i){
+		buffer.add_occluder(proxy, Transform::matrix(attributes.template shadow_read<I>(batch_offsets[model] + i)));
+	}
+}
+template<typename Storage, typename... Attribs>
+size_t BasicMultiRenderBatch<Storage, Attribs...>::visible_instances() const {
+	if (culling == CullMode::CPU){
+		return visible_count;
+	}
+	return std::accumulate(batch_sizes.begin(), batch_sizes.end(), size_t{0});
+}
+template<typename Storage, typename... Attribs>
+template<size_t I>
+void BasicMultiRenderBatch<Storage, Attribs...>::sort_front_to_back(const glm::mat4 &view){
+	using Transform = detail::InstanceTransform<typename detail::TypeAt<I, Attribs...>::type>;
+	std::vector<float> depths;
+	std::vector<uint16_t> keys;
+	std::vector<uint32_t> order;
+	std::vector<InstanceHandle> handles;
+	for (size_t m = 0; m < batch_sizes.size(); ++m){
+		const size_t base = batch_offsets[m];
+		const size_t n = batch_sizes[m];
+		if (n < 2){
+			continue;
+		}
+		//The camera looks down -z in view space so depth is the negated z of the instance's origin
+		depths.resize(n);
+		for (size_t i = 0; i < n; ++i){
+			depths[i] = -(view * Transform::matrix(attributes.template shadow_read<I>(base + i))[3]).z;
+		}
+		const auto range = std::minmax_element(depths.begin(), depths.end());
+		const float closest = *range.first;
+		const float scale = *range.second > closest ? 65535.f / (*range.second - closest) : 0.f;
+		keys.resize(n);
+		order.resize(n);
+		for (size_t i = 0; i < n; ++i){
+			keys[i] = static_cast<uint16_t>((depths[i] - closest) * scale);
+			order[i] = static_cast<uint32_t>(i);
+		}
+		util::radix_sort(keys, order);
+
+		attributes.shadow_permute(base, order.data(), n);
+		handles.assign(instance_handles.begin() + base, instance_handles.begin() + base + n);
+		for (size_t i = 0; i < n; ++i){
+			instance_handles[base + i] = handles[order[i]];
+			handle_refs[handles[order[i]]].index = i;
+			update_bounds(m, base + i);
+		}
+	}
+}
+template<typename Storage, typename... Attribs>
+template<size_t I>
+void BasicMultiRenderBatch<Storage, Attribs...>::set_transform_attrib(){
+	using T = typename detail::TypeAt<I, Attribs...>::type;
+	transform_offset = attributes.offset(I);
+	transform_format = detail::InstanceTransform<T>::format;
+	read_transform = &decode_transform<T>;
+}
+template<typename Storage, typename... Attribs>
 template<typename T>
-void MultiRenderBatch<Attribs...>::set_attrib_index(){
-	int index = sizeof...(Attribs) - 1;
-	size_t base_offset = attributes.offset(index);
-	GLenum gl_type = detail::gl_attrib_type<T>();
-	//number of occupied indices is rounded based on vec4
-	//would we want to use the Sizer for this?
-	size_t attrib_size = detail::Size<Layout::PACKED, T>::size();
-	size_t num_indices = attrib_size / sizeof(glm::vec4);
-	num_indices = attrib_size % sizeof(glm::vec4) == 0 ? num_indices : num_indices + 1;
-	for (size_t i = 0; i < num_indices; ++i){
-		glEnableVertexAttribArray(i + indices[index]);
-		if (gl_type == GL_FLOAT || gl_type == GL_HALF_FLOAT || gl_type == GL_DOUBLE){
-			//TODO: How should we work through computing the number of values we're sending?
-			//or is just saying 4 fine
-			glVertexAttribPointer(i + indices[index], 4, gl_type, GL_FALSE, attributes.stride(),
-					(void*)(base_offset + sizeof(glm::vec4) * i));
+glm::mat4 BasicMultiRenderBatch<Storage, Attribs...>::decode_transform(const char *attribs){
+	T t;
+	std::memcpy(&t, attribs, sizeof(T));
+	return detail::InstanceTransform<T>::matrix(t);
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::setup_culling(CullMode mode){
+	culled_attributes = BasicPackedBuffer<Storage, Attribs...>{attributes.size(), GL_ARRAY_BUFFER, GL_STREAM_COPY};
+	culled_attributes.set_mem_category(MemCategory::INSTANCE);
+	culled_commands = BasicPackedBuffer<Storage, DrawElementsIndirectCommand>{draw_commands.size(),
+		GL_DRAW_INDIRECT_BUFFER, GL_STREAM_DRAW};
+	culled_commands.enable_shadow(false);
+	culling = mode;
+	rebind_attributes(std::integral_constant<bool, Storage::device>{});
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::cull_gpu(const Frustum &frustum, std::true_type){
+	//Reset the culled commands to draw nothing, the shader counts the visible instances back in
+	for (size_t m = 0; m < batch_sizes.size(); ++m){
+		const DrawElementsIndirectCommand &cmd = draw_commands.template shadow_read<0>(m);
+		culled_commands.template shadow_write<0>(m) = DrawElementsIndirectCommand{cmd.count, 0,
+			cmd.first_index, cmd.base_vertex, cmd.base_instance};
+	}
+	culled_commands.flush_shadow();
+	const size_t max_instances = *std::max_element(batch_sizes.begin(), batch_sizes.end());
+	if (max_instances == 0 && !compact_program){
+		return;
+	}
+
+	glUseProgram(cull_program);
+	glUniform4fv(planes_unif, 6, &frustum.all_planes()[0].x);
+	glUniform1ui(stride_unif, attributes.stride() / 4);
+	glUniform1ui(transform_unif, transform_offset / 4);
+	glUniform1ui(transform_format_unif, transform_format);
+	attributes.bind_base(GL_SHADER_STORAGE_BUFFER, 0);
+	culled_attributes.bind_base(GL_SHADER_STORAGE_BUFFER, 1);
+	draw_commands.bind_base(GL_SHADER_STORAGE_BUFFER, 2);
+	culled_commands.bind_base(GL_SHADER_STORAGE_BUFFER, 3);
+	model_bounds.bind_base(4);
+	if (occluders){
+		glUniform1i(hiz_levels_unif, occluders->levels());
+		glUniformMatrix4fv(hiz_view_proj_unif, 1, GL_FALSE, &occluders->view_proj()[0][0]);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, occluders->texture());
+	}
+	else {
+		glUniform1i(hiz_levels_unif, 0);
+	}
+	if (max_instances > 0){
+		glDispatchCompute((max_instances + 63) / 64, batch_sizes.size(), 1);
+	}
+	if (compact_program){
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		glUseProgram(compact_program);
+		compacted_commands.bind_base(GL_SHADER_STORAGE_BUFFER, 5);
+		draw_count.bind_base(GL_SHADER_STORAGE_BUFFER, 6);
+		glDispatchCompute(1, 1, 1);
+	}
+	//The results are read as draw commands, the draw count and instance attributes, or from
+	//storage when the vertex shader fetches instances itself, and the culled commands are
+	//reset by a buffer upload next frame after the shader's atomics
+	GLbitfield barriers = GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT;
+	if (fetch == InstanceFetch::STORAGE){
+		barriers |= GL_SHADER_STORAGE_BARRIER_BIT;
+	}
+	glMemoryBarrier(barriers);
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::cull_gpu(const Frustum&, std::false_type){
+	assert(false);
+}
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::cull_cpu(const Frustum &frustum){
+	//Split the batches into chunks to spread over the pool, each chunk writes the indices
+	//of its visible instances to the start of its own range of visible_indices
+	const size_t chunk_size = 4096;
+	struct Chunk {
+		size_t model, begin, end, visible, dst;
+	};
+	std::vector<Chunk> chunks;
+	for (size_t m = 0; m < batch_sizes.size(); ++m){
+		for (size_t b = 0; b < batch_sizes[m]; b += chunk_size){
+			const size_t begin = batch_offsets[m] + b;
+			chunks.push_back(Chunk{m, begin, begin + std::min(chunk_size, batch_sizes[m] - b), 0, 0});
 		}
-		else {
-			glVertexAttribIPointer(i + indices[index], 4, gl_type, attributes.stride(),
-					(void*)(base_offset + sizeof(glm::vec4) * i));
+	}
+	cull_pool->run(chunks.size(), [&](size_t c){
+		Chunk &ch = chunks[c];
+		ch.visible = cpu_cull::cull_bounds(frustum, instance_bounds, ch.begin, ch.end, &visible_indices[ch.begin]);
+		if (software_occluders){
+			ch.visible = software_occluders->test_bounds(instance_bounds, &visible_indices[ch.begin], ch.visible,
+				&visible_indices[ch.begin]);
+		}
+	});
+
+	//Place each chunk's visible instances after those of the previous chunks of its model
+	std::vector<size_t> model_visible(batch_sizes.size(), 0);
+	visible_count = 0;
+	for (auto &ch : chunks){
+		ch.dst = batch_offsets[ch.model] + model_visible[ch.model];
+		model_visible[ch.model] += ch.visible;
+		visible_count += ch.visible;
+	}
+	if (visible_count > 0){
+		const size_t stride = attributes.stride();
+		//The whole buffer is rewritten each cull so let the driver hand us fresh storage
+		//instead of waiting for last frame's draw to finish reading it
+		culled_attributes.map_range(0, culled_attributes.size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		cull_pool->run(chunks.size(), [&](size_t c){
+			const Chunk &ch = chunks[c];
+			for (size_t i = 0; i < ch.visible; ++i){
+				std::memcpy(culled_attributes.mapped_block(ch.dst + i),
+					attributes.shadow_block(visible_indices[ch.begin + i]), stride);
+			}
+		});
+		culled_attributes.unmap();
+	}
+	//Only the models with visible instances get a draw
+	culled_draws = 0;
+	for (size_t m = 0; m < batch_sizes.size(); ++m){
+		if (model_visible[m] > 0){
+			const DrawElementsIndirectCommand &cmd = draw_commands.template shadow_read<0>(m);
+			culled_commands.template shadow_write<0>(culled_draws++) = DrawElementsIndirectCommand{cmd.count,
+				static_cast<GLuint>(model_visible[m]), cmd.first_index, cmd.base_vertex, cmd.base_instance};
 		}
-		glVertexAttribDivisor(i + indices[index], 1);
 	}
+	culled_commands.flush_shadow();
 }
-template<typename... Attribs>
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::update_bounds(size_t model, size_t i){
+	if (culling == CullMode::CPU){
+		instance_bounds.set(i, cull_model_bounds[model].transform(read_transform(attributes.shadow_block(i)
+			+ transform_offset)));
+	}
+}
+template<typename Storage, typename... Attribs>
+template<typename T>
+void BasicMultiRenderBatch<Storage, Attribs...>::set_attrib_index(){
+	int index = sizeof...(Attribs) - 1;
+	size_t base_offset = attributes.offset(index);
+	//Matrices occupy an index per column
+	const AttribFormat fmt = detail::attrib_format<T>();
+	for (size_t i = 0; i < fmt.slots; ++i){
+		set_attrib_slot(i + indices[index], fmt, base_offset + fmt.slot_stride * i);
+	}
+}
+template<typename Storage, typename... Attribs>
 template<typename A, typename B, typename... Args>
-void MultiRenderBatch<Attribs...>::set_attrib_index(){
+void BasicMultiRenderBatch<Storage, Attribs...>::set_attrib_index(){
 	int index = sizeof...(Attribs) - sizeof...(Args) - 2;
 	size_t base_offset = attributes.offset(index);
-	GLenum gl_type = detail::gl_attrib_type<A>();
-	//number of occupied indices is rounded based on vec4
-	//would we want to use the Sizer for this?
-	size_t attrib_size = detail::Size<Layout::PACKED, A>::size();
-	size_t num_indices = attrib_size / sizeof(glm::vec4);
-	num_indices = attrib_size % sizeof(glm::vec4) == 0 ? num_indices : num_indices + 1;
-	for (size_t i = 0; i < num_indices; ++i){
-		glEnableVertexAttribArray(i + indices[index]);
-		if (gl_type == GL_FLOAT || gl_type == GL_HALF_FLOAT || gl_type == GL_DOUBLE){
-			//TODO: How should we work through computing the number of values we're sending?
-			//or is just saying 4 fine
-			glVertexAttribPointer(i + indices[index], 4, gl_type, GL_FALSE, attributes.stride(),
-					(void*)(base_offset + sizeof(glm::vec4) * i));
-		}
-		else {
-			glVertexAttribIPointer(i + indices[index], 4, gl_type, attributes.stride(),
-					(void*)(base_offset + sizeof(glm::vec4) * i));
-		}
-		glVertexAttribDivisor(i + indices[index], 1);
+	const AttribFormat fmt = detail::attrib_format<A>();
+	for (size_t i = 0; i < fmt.slots; ++i){
+		set_attrib_slot(i + indices[index], fmt, base_offset + fmt.slot_stride * i);
 		//Check that we didn't spill over into another attributes index space
 		if (static_cast<int>(i) + indices[index] >= indices[index + 1]){
 			std::cerr << "MultiRenderBatch Warning: attribute " << indices[index]
@@ -202,5 +1159,31 @@ void MultiRenderBatch<Attribs...>::set_attrib_index(){
 	set_attrib_index<B, Args...>();
 }
 
-#endif
+template<typename Storage, typename... Attribs>
+void BasicMultiRenderBatch<Storage, Attribs...>::set_attrib_slot(GLuint slot, const AttribFormat &fmt, size_t offset){
+	if (dsa){
+		glEnableVertexArrayAttrib(vao, slot);
+		if (fmt.integer){
+			glVertexArrayAttribIFormat(vao, slot, fmt.components, fmt.type, offset);
+		}
+		else {
+			glVertexArrayAttribFormat(vao, slot, fmt.components, fmt.type, fmt.normalized, offset);
+		}
+		glVertexArrayAttribBinding(vao, slot, 1);
+	}
+	else {
+		glEnableVertexAttribArray(slot);
+		if (fmt.integer){
+			glVertexAttribIFormat(slot, fmt.components, fmt.type, offset);
+		}
+		else {
+			glVertexAttribFormat(slot, fmt.components, fmt.type, fmt.normalized, offset);
+		}
+		glVertexAttribBinding(slot, 1);
+	}
+}
 
+template<typename... Attribs>
+using MultiRenderBatch = BasicMultiRenderBatch<GLStorage, Attribs...>;
+
+#endif
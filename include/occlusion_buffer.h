@@ -0,0 +1,95 @@
+#ifndef OCCLUSION_BUFFER_H
+#define OCCLUSION_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.h"
+#include "cpu_cull.h"
+#include "thread_pool.h"
+
+/*
+ * A low poly stand in for a model drawn into an OcclusionBuffer. The proxy must fit
+ * inside the model it stands in for or it will hide things the model doesn't
+ */
+struct OccluderMesh {
+	std::vector<glm::vec3> verts;
+	std::vector<uint32_t> indices;
+
+	/*
+	 * Make a proxy of the 12 triangles of the box
+	 */
+	static OccluderMesh box(const AABB &box);
+};
+
+/*
+ * A small depth buffer rasterized in software for occlusion culling without the GPU.
+ * Occluder proxies are added between begin and rasterize, which draws them on a thread
+ * pool with each thread filling its own strip of rows, 4 pixels at a time with SIMD.
+ * Afterwards boxes can be tested against the occluders from any number of threads.
+ * Depth is stored as window depth in [0, 1] like the default GL depth range
+ */
+class OcclusionBuffer {
+	//A triangle set up for rasterizing as its edge functions and depth plane, each as
+	//a * x + b * y + c in pixels, along with its bounds on screen
+	struct Triangle {
+		float ea[3], eb[3], ec[3];
+		float za, zb, zc;
+		int x0, y0, x1, y1;
+	};
+
+	size_t buf_width, buf_height, stride;
+	std::vector<float> depth_buf;
+	std::vector<Triangle> triangles;
+	glm::mat4 occluder_view_proj;
+
+public:
+	/*
+	 * Create a buffer of width x height pixels
+	 */
+	OcclusionBuffer(size_t width, size_t height);
+	/*
+	 * Clear the buffer and the occluders to start drawing occluders seen with the view-projection
+	 * matrix passed
+	 */
+	void begin(const glm::mat4 &view_proj);
+	/*
+	 * Add the proxy transformed by the matrix to the occluders. Triangles crossing the near
+	 * plane are dropped instead of clipped, which only loses some occlusion
+	 */
+	void add_occluder(const OccluderMesh &mesh, const glm::mat4 &transform);
+	/*
+	 * Rasterize the occluders added since begin on the pool
+	 */
+	void rasterize(ThreadPool &pool);
+	/*
+	 * Check if some of the box may be visible past the occluders
+	 */
+	bool visible(const AABB &box) const;
+	/*
+	 * Filter the count boxes in bounds whose indices are in indices down to those which may be
+	 * visible, writing their indices to visible in the same order. visible may be indices
+	 * to filter in place. Returns the number written
+	 */
+	size_t test_bounds(const BoundsSoA &bounds, const uint32_t *indices, size_t count, uint32_t *visible) const;
+	size_t width() const;
+	size_t height() const;
+	/*
+	 * Get the depth of the nearest occluder at pixel (x, y)
+	 */
+	float depth(size_t x, size_t y) const;
+	size_t occluder_triangles() const;
+
+private:
+	/*
+	 * Rasterize all the occluders over the rows [row_begin, row_end)
+	 */
+	void rasterize_rows(int row_begin, int row_end);
+	/*
+	 * Check if the box with the center and extent passed may be visible
+	 */
+	bool visible(const glm::vec3 &center, const glm::vec3 &extent) const;
+};
+
+#endif
+
@@ -0,0 +1,251 @@
+#ifndef PACKED_ATTRIBS_H
+#define PACKED_ATTRIBS_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+#include <glm/glm.hpp>
+
+/*
+ * Compact vertex attribute types which are expanded back to floats by the
+ * vertex fetch. Their GL types, component counts and normalization are given
+ * by AttribFormat in glattrib_type.h. These are meant for vertex and instance
+ * buffers in the PACKED layout, GLSL blocks have no matching member types
+ */
+namespace detail {
+/*
+ * Convert a float to an IEEE half float, rounding to nearest even
+ * Values too large for a half become infinity and NaNs stay NaN
+ */
+inline uint16_t float_to_half(float f){
+	uint32_t x;
+	std::memcpy(&x, &f, sizeof(x));
+	const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000);
+	x &= 0x7fffffff;
+	uint16_t h = 0;
+	//Overflows to infinity or is already infinity/NaN
+	if (x >= 0x47800000){
+		h = x > 0x7f800000 ? 0x7e00 : 0x7c00;
+	}
+	//Becomes a half denormal or zero, adding 0.5 lines the mantissa bits
+	//we want up at the bottom of the float and has the FPU round them for us
+	else if (x < 0x38800000){
+		float a;
+		std::memcpy(&a, &x, sizeof(a));
+		a += 0.5f;
+		std::memcpy(&x, &a, sizeof(x));
+		h = static_cast<uint16_t>(x - 0x3f000000);
+	}
+	//Normal range, rebias the exponent and round the dropped mantissa bits
+	else {
+		const uint32_t mant_odd = (x >> 13) & 1;
+		x += 0xc8000fff + mant_odd;
+		h = static_cast<uint16_t>(x >> 13);
+	}
+	return h | sign;
+}
+inline float half_to_float(uint16_t h){
+	const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+	const uint32_t exp = (h >> 10) & 0x1f;
+	const uint32_t mant = h & 0x3ff;
+	if (exp == 0){
+		const float f = std::ldexp(static_cast<float>(mant), -24);
+		return sign ? -f : f;
+	}
+	uint32_t x = exp == 31 ? sign | 0x7f800000 | (mant << 13)
+		: sign | ((exp + 112) << 23) | (mant << 13);
+	float f;
+	std::memcpy(&f, &x, sizeof(f));
+	return f;
+}
+/*
+ * Convert a float in [0, 1] or [-1, 1] to an unsigned or signed normalized integer
+ * with max as its largest value, out of range values are clamped
+ */
+inline uint32_t to_unorm(float f, float max){
+	return static_cast<uint32_t>(std::round(std::min(std::max(f, 0.f), 1.f) * max));
+}
+inline int32_t to_snorm(float f, float max){
+	return static_cast<int32_t>(std::round(std::min(std::max(f, -1.f), 1.f) * max));
+}
+/*
+ * The axis each column of a GridTransform's rotation lies along for each of its
+ * permutation codes, the shaders decoding grid transforms use the same table
+ */
+static const int GRID_AXES[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+}
+
+/*
+ * Two and four component half float vectors, GL_HALF_FLOAT
+ */
+struct Half2 {
+	uint16_t x, y;
+
+	Half2() : x(0), y(0){}
+	Half2(const glm::vec2 &v) : x(detail::float_to_half(v.x)), y(detail::float_to_half(v.y)){}
+	glm::vec2 unpack() const {
+		return glm::vec2{detail::half_to_float(x), detail::half_to_float(y)};
+	}
+};
+struct Half4 {
+	uint16_t x, y, z, w;
+
+	Half4() : x(0), y(0), z(0), w(0){}
+	Half4(const glm::vec4 &v) : x(detail::float_to_half(v.x)), y(detail::float_to_half(v.y)),
+		z(detail::float_to_half(v.z)), w(detail::float_to_half(v.w))
+	{}
+	glm::vec4 unpack() const {
+		return glm::vec4{detail::half_to_float(x), detail::half_to_float(y),
+			detail::half_to_float(z), detail::half_to_float(w)};
+	}
+};
+/*
+ * An RGBA8 colour, each channel a GL_UNSIGNED_BYTE normalized to [0, 1]
+ */
+struct UNorm8x4 {
+	uint8_t r, g, b, a;
+
+	UNorm8x4() : r(0), g(0), b(0), a(0){}
+	UNorm8x4(const glm::vec4 &c) : r(static_cast<uint8_t>(detail::to_unorm(c.x, 255.f))),
+		g(static_cast<uint8_t>(detail::to_unorm(c.y, 255.f))), b(static_cast<uint8_t>(detail::to_unorm(c.z, 255.f))),
+		a(static_cast<uint8_t>(detail::to_unorm(c.w, 255.f)))
+	{}
+	UNorm8x4(const glm::vec3 &c, float alpha = 1.f) : UNorm8x4(glm::vec4{c, alpha}){}
+	glm::vec4 unpack() const {
+		return glm::vec4{r / 255.f, g / 255.f, b / 255.f, a / 255.f};
+	}
+};
+/*
+ * Two and four component GL_SHORT vectors normalized to [-1, 1]
+ */
+struct SNorm16x2 {
+	int16_t x, y;
+
+	SNorm16x2() : x(0), y(0){}
+	SNorm16x2(const glm::vec2 &v) : x(static_cast<int16_t>(detail::to_snorm(v.x, 32767.f))),
+		y(static_cast<int16_t>(detail::to_snorm(v.y, 32767.f)))
+	{}
+	glm::vec2 unpack() const {
+		return glm::vec2{std::max(x / 32767.f, -1.f), std::max(y / 32767.f, -1.f)};
+	}
+};
+struct SNorm16x4 {
+	int16_t x, y, z, w;
+
+	SNorm16x4() : x(0), y(0), z(0), w(0){}
+	SNorm16x4(const glm::vec4 &v) : x(static_cast<int16_t>(detail::to_snorm(v.x, 32767.f))),
+		y(static_cast<int16_t>(detail::to_snorm(v.y, 32767.f))), z(static_cast<int16_t>(detail::to_snorm(v.z, 32767.f))),
+		w(static_cast<int16_t>(detail::to_snorm(v.w, 32767.f)))
+	{}
+	SNorm16x4(const glm::vec3 &v, float w = 0.f) : SNorm16x4(glm::vec4{v, w}){}
+	glm::vec4 unpack() const {
+		return glm::vec4{std::max(x / 32767.f, -1.f), std::max(y / 32767.f, -1.f),
+			std::max(z / 32767.f, -1.f), std::max(w / 32767.f, -1.f)};
+	}
+};
+/*
+ * A normal packed as GL_INT_2_10_10_10_REV, three signed 10 bit components
+ * and a 2 bit w all normalized to [-1, 1]. x is in the low bits
+ */
+struct PackedNormal {
+	uint32_t bits;
+
+	PackedNormal() : bits(0){}
+	PackedNormal(const glm::vec3 &n, float w = 0.f)
+		: bits((static_cast<uint32_t>(detail::to_snorm(n.x, 511.f)) & 0x3ff)
+			| (static_cast<uint32_t>(detail::to_snorm(n.y, 511.f)) & 0x3ff) << 10
+			| (static_cast<uint32_t>(detail::to_snorm(n.z, 511.f)) & 0x3ff) << 20
+			| (static_cast<uint32_t>(detail::to_snorm(w, 1.f)) & 0x3) << 30)
+	{}
+	glm::vec4 unpack() const {
+		return glm::vec4{std::max(component(0, 10) / 511.f, -1.f), std::max(component(10, 10) / 511.f, -1.f),
+			std::max(component(20, 10) / 511.f, -1.f), std::max(component(30, 2) / 1.f, -1.f)};
+	}
+
+private:
+	//Sign extend the width bit component starting at bit shift
+	int32_t component(int shift, int width) const {
+		const uint32_t c = (bits >> shift) & ((1u << width) - 1);
+		return c & (1u << (width - 1)) ? static_cast<int32_t>(c) - (1 << width) : static_cast<int32_t>(c);
+	}
+};
+
+/*
+ * An instance transform for objects placed on an integer grid, 8 bytes instead of the 64 of
+ * a mat4. The grid position is stored as GL_SHORTs followed by a code packing the orientation
+ * and a uniform scale, all sent as an integer ivec4 and decoded to a matrix in the shader.
+ * The orientation is one of the 48 ways of mapping the axes onto each other, with bits 0-2
+ * picking the permutation of the axes and bits 3-5 flipping the x, y and z columns. Flips
+ * which leave the determinant negative are reflections, which also flip the triangle winding.
+ * The scale is in bits 8-15 in sixteenths, giving scales from 1/16 to just under 16
+ */
+struct GridTransform {
+	int16_t x, y, z;
+	uint16_t code;
+
+	GridTransform() : x(0), y(0), z(0), code(16 << 8){}
+	GridTransform(const glm::ivec3 &pos, uint16_t orientation = 0, float scale = 1.f)
+		: x(static_cast<int16_t>(pos.x)), y(static_cast<int16_t>(pos.y)), z(static_cast<int16_t>(pos.z)),
+		code(static_cast<uint16_t>((orientation & 0x3f)
+			| std::min(std::max(static_cast<int>(std::round(scale * 16.f)), 1), 255) << 8))
+	{}
+	/*
+	 * Snap a transform made of a translation, rotations by multiples of 90 degrees
+	 * and a uniform scale onto the grid
+	 */
+	GridTransform(const glm::mat4 &m) : GridTransform(glm::ivec3{static_cast<int>(std::round(m[3].x)),
+		static_cast<int>(std::round(m[3].y)), static_cast<int>(std::round(m[3].z))},
+		orientation(glm::mat3{m}), glm::length(glm::vec3{m[0]}))
+	{}
+	uint16_t orientation() const {
+		return code & 0x3f;
+	}
+	float scale() const {
+		return (code >> 8) / 16.f;
+	}
+	glm::mat4 unpack() const {
+		const int p = std::min(code & 7, 5);
+		const float s = scale();
+		glm::mat4 m{1.f};
+		for (int c = 0; c < 3; ++c){
+			m[c] = glm::vec4{0.f};
+			m[c][detail::GRID_AXES[p][c]] = (code >> (3 + c)) & 1 ? -s : s;
+		}
+		m[3] = glm::vec4(x, y, z, 1.f);
+		return m;
+	}
+	/*
+	 * Get the orientation code of a rotation matrix, which must be made of rotations
+	 * by multiples of 90 degrees and possibly reflections
+	 */
+	static uint16_t orientation(const glm::mat3 &rot){
+		//Find which axis each column lies along and if it points the negative way
+		int axes[3];
+		uint16_t flips = 0;
+		for (int c = 0; c < 3; ++c){
+			axes[c] = 0;
+			for (int r = 1; r < 3; ++r){
+				if (std::abs(rot[c][r]) > std::abs(rot[c][axes[c]])){
+					axes[c] = r;
+				}
+			}
+			if (rot[c][axes[c]] < 0.f){
+				flips |= 1 << c;
+			}
+		}
+		for (uint16_t p = 0; p < 6; ++p){
+			if (detail::GRID_AXES[p][0] == axes[0] && detail::GRID_AXES[p][1] == axes[1]
+				&& detail::GRID_AXES[p][2] == axes[2])
+			{
+				return p | flips << 3;
+			}
+		}
+		assert(false);
+		return 0;
+	}
+};
+
+#endif
+
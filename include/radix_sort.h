@@ -0,0 +1,50 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace util {
+/*
+ * Sort the unsigned integer keys ascending with an LSD radix sort a byte at a time,
+ * moving values along with them. The sort is stable, so equal keys keep the order
+ * of their values. Passes over bytes which are the same for every key are skipped,
+ * so keys only using their low bits cost only as many passes as they need
+ */
+template<typename Key, typename Value>
+void radix_sort(std::vector<Key> &keys, std::vector<Value> &values){
+	static_assert(std::is_unsigned<Key>::value, "Radix sort keys must be unsigned integers");
+	const size_t n = keys.size();
+	std::vector<Key> key_tmp(n);
+	std::vector<Value> value_tmp(n);
+	for (size_t shift = 0; shift < 8 * sizeof(Key); shift += 8){
+		std::array<size_t, 256> counts{};
+		for (const auto &k : keys){
+			++counts[(k >> shift) & 0xff];
+		}
+		if (n == 0 || counts[(keys[0] >> shift) & 0xff] == n){
+			continue;
+		}
+		size_t offset = 0;
+		for (auto &c : counts){
+			const size_t count = c;
+			c = offset;
+			offset += count;
+		}
+		for (size_t i = 0; i < n; ++i){
+			const size_t dst = counts[(keys[i] >> shift) & 0xff]++;
+			key_tmp[dst] = keys[i];
+			value_tmp[dst] = std::move(values[i]);
+		}
+		std::swap(keys, key_tmp);
+		std::swap(values, value_tmp);
+	}
+}
+}
+
+#endif
+
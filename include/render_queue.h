@@ -0,0 +1,90 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "gl_core_4_4.h"
+
+/*
+ * A texture to bind to a texture unit for a draw, a texture of 0 binds nothing
+ */
+struct TextureBinding {
+	GLuint unit;
+	GLenum target;
+	GLuint texture;
+
+	TextureBinding(GLuint unit = 0, GLenum target = GL_TEXTURE_2D, GLuint texture = 0)
+		: unit(unit), target(target), texture(texture)
+	{}
+};
+
+/*
+ * A draw submitted to the RenderQueue. The queue binds the program, VAO and texture
+ * before calling draw, which should only issue the draw calls. Packets are drawn in
+ * order of pass, then program, VAO and texture to group state changes, then depth
+ * which should be in [0, 1], nearest first
+ */
+struct DrawPacket {
+	uint32_t pass;
+	GLuint program, vao;
+	TextureBinding texture;
+	float depth;
+	std::function<void()> draw;
+};
+
+/*
+ * Counts of the work done drawing a queue
+ */
+struct RenderStats {
+	size_t draws, program_changes, vao_changes, texture_changes;
+
+	RenderStats() : draws(0), program_changes(0), vao_changes(0), texture_changes(0){}
+};
+
+/*
+ * Collects the draws for a frame and submits them sorted by a 64 bit key so draws sharing
+ * state are made together, skipping the state changes between them. From the high bits
+ * down the key holds the pass, program, VAO, texture and depth. Programs, VAOs and textures
+ * are given small ids in the order they're first seen each frame to fit in the key, so their
+ * GL names can be anything and deleted names being reused doesn't use up ids
+ */
+class RenderQueue {
+	//Bits of the key used for each field, from the high bits down
+	static constexpr int PASS_BITS = 4, STATE_BITS = 12, DEPTH_BITS = 24;
+
+	std::vector<DrawPacket> packets;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> order;
+	std::unordered_map<GLuint, uint32_t> program_ids, vao_ids, texture_ids;
+	RenderStats stats;
+
+public:
+	/*
+	 * Add a draw to the queue for the next flush
+	 */
+	void submit(DrawPacket packet);
+	/*
+	 * Sort and draw the queued packets then empty the queue. The state bound by the
+	 * last packet is left bound
+	 */
+	void flush();
+	/*
+	 * Get the number of packets waiting for the next flush
+	 */
+	size_t size() const;
+	/*
+	 * Get the counts of draws and state changes made by the last flush
+	 */
+	const RenderStats& last_stats() const;
+
+private:
+	/*
+	 * Get the id of a program, VAO or texture name in the map, assigning the next one if it's new
+	 */
+	static uint32_t state_id(std::unordered_map<GLuint, uint32_t> &ids, GLuint name);
+};
+
+#endif
+
@@ -0,0 +1,12 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+//SSE is baseline on x86-64 so HAS_SSE is defined there and the SIMD paths
+//fall back to scalar loops elsewhere
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define HAS_SSE
+#include <xmmintrin.h>
+#endif
+
+#endif
+
@@ -0,0 +1,200 @@
+#ifndef SIMD_PACK_H
+#define SIMD_PACK_H
+
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <glm/glm.hpp>
+#include "simd.h"
+
+namespace detail {
+/*
+ * Number of 4 byte components in T if it's a 32 bit scalar or a vector of them
+ * which we can shuffle into padded slots as floats, 0 if T must be copied normally
+ */
+template<typename T>
+struct PackWidth {
+	static constexpr size_t value = (std::is_same<T, float>::value || std::is_same<T, int32_t>::value
+		|| std::is_same<T, uint32_t>::value) ? 1 : 0;
+};
+template<>
+struct PackWidth<glm::vec2> {
+	static constexpr size_t value = 2;
+};
+template<>
+struct PackWidth<glm::ivec2> {
+	static constexpr size_t value = 2;
+};
+template<>
+struct PackWidth<glm::uvec2> {
+	static constexpr size_t value = 2;
+};
+template<>
+struct PackWidth<glm::vec3> {
+	static constexpr size_t value = 3;
+};
+template<>
+struct PackWidth<glm::ivec3> {
+	static constexpr size_t value = 3;
+};
+template<>
+struct PackWidth<glm::uvec3> {
+	static constexpr size_t value = 3;
+};
+
+/*
+ * Copy count tightly packed values of W 4 byte components from src into
+ * the start of consecutive 16 byte slots at dst. The rest of each slot is padding
+ * and may be overwritten with junk so whole slots can be stored at once
+ */
+template<size_t W>
+void pack_slots(const char *src, char *dst, size_t count){
+	static_assert(W >= 1 && W <= 3, "Only 1 to 3 components are padded out to a slot");
+	size_t i = 0;
+#ifdef HAS_SSE
+	const size_t whole = count - count % 4;
+	const float *s = reinterpret_cast<const float*>(src);
+	float *d = reinterpret_cast<float*>(dst);
+	//Each iteration handles 4 values, which is 4, 8 or 12 floats and fills 4 slots
+	if (W == 1){
+		for (; i < whole; i += 4, s += 4, d += 16){
+			__m128 v = _mm_loadu_ps(s);
+			_mm_storeu_ps(d, v);
+			_mm_storeu_ps(d + 4, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+			_mm_storeu_ps(d + 8, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+			_mm_storeu_ps(d + 12, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+		}
+	}
+	else if (W == 2){
+		for (; i < whole; i += 4, s += 8, d += 16){
+			__m128 a = _mm_loadu_ps(s);
+			__m128 b = _mm_loadu_ps(s + 4);
+			_mm_storeu_ps(d, a);
+			_mm_storeu_ps(d + 4, _mm_movehl_ps(a, a));
+			_mm_storeu_ps(d + 8, b);
+			_mm_storeu_ps(d + 12, _mm_movehl_ps(b, b));
+		}
+	}
+	else if (W == 3){
+		//a = [x0 y0 z0 x1], b = [y1 z1 x2 y2], c = [z2 x3 y3 z3]
+		for (; i < whole; i += 4, s += 12, d += 16){
+			__m128 a = _mm_loadu_ps(s);
+			__m128 b = _mm_loadu_ps(s + 4);
+			__m128 c = _mm_loadu_ps(s + 8);
+			__m128 t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 3));
+			_mm_storeu_ps(d, a);
+			_mm_storeu_ps(d + 4, _mm_shuffle_ps(t, b, _MM_SHUFFLE(1, 1, 2, 0)));
+			_mm_storeu_ps(d + 8, _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 0, 3, 2)));
+			_mm_storeu_ps(d + 12, _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 2, 1)));
+		}
+	}
+#endif
+	for (; i < count; ++i){
+		std::memcpy(dst + 16 * i, src + 4 * W * i, 4 * W);
+	}
+}
+/*
+ * Copy count values of W 4 byte components from the start of consecutive
+ * 16 byte slots at src into tightly packed values at dst, dropping the padding
+ */
+template<size_t W>
+void unpack_slots(const char *src, char *dst, size_t count){
+	static_assert(W >= 1 && W <= 3, "Only 1 to 3 components are padded out to a slot");
+	size_t i = 0;
+#ifdef HAS_SSE
+	const size_t whole = count - count % 4;
+	const float *s = reinterpret_cast<const float*>(src);
+	float *d = reinterpret_cast<float*>(dst);
+	if (W == 1){
+		for (; i < whole; i += 4, s += 16, d += 4){
+			__m128 xy = _mm_unpacklo_ps(_mm_loadu_ps(s), _mm_loadu_ps(s + 4));
+			__m128 zw = _mm_unpacklo_ps(_mm_loadu_ps(s + 8), _mm_loadu_ps(s + 12));
+			_mm_storeu_ps(d, _mm_movelh_ps(xy, zw));
+		}
+	}
+	else if (W == 2){
+		for (; i < whole; i += 4, s += 16, d += 8){
+			_mm_storeu_ps(d, _mm_movelh_ps(_mm_loadu_ps(s), _mm_loadu_ps(s + 4)));
+			_mm_storeu_ps(d + 4, _mm_movelh_ps(_mm_loadu_ps(s + 8), _mm_loadu_ps(s + 12)));
+		}
+	}
+	else if (W == 3){
+		for (; i < whole; i += 4, s += 16, d += 12){
+			__m128 p0 = _mm_loadu_ps(s);
+			__m128 p1 = _mm_loadu_ps(s + 4);
+			__m128 p2 = _mm_loadu_ps(s + 8);
+			__m128 p3 = _mm_loadu_ps(s + 12);
+			__m128 t = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(0, 0, 2, 2));
+			_mm_storeu_ps(d, _mm_shuffle_ps(p0, t, _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(d + 4, _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(1, 0, 2, 1)));
+			t = _mm_shuffle_ps(p2, p3, _MM_SHUFFLE(0, 0, 2, 2));
+			_mm_storeu_ps(d + 8, _mm_shuffle_ps(t, p3, _MM_SHUFFLE(2, 1, 2, 0)));
+		}
+	}
+#endif
+	for (; i < count; ++i){
+		std::memcpy(dst + 4 * W * i, src + 16 * i, 4 * W);
+	}
+}
+/*
+ * Copy count elements between tightly packed memory and an array with the stride passed,
+ * for types we can't shuffle into slots this is all that's done
+ */
+template<typename T>
+void pack_strided(const T *src, char *dst, size_t count, size_t stride, std::integral_constant<size_t, 0>){
+	for (size_t i = 0; i < count; ++i){
+		std::memcpy(dst + stride * i, src + i, sizeof(T));
+	}
+}
+template<typename T, size_t W>
+void pack_strided(const T *src, char *dst, size_t count, size_t stride, std::integral_constant<size_t, W>){
+	if (stride == 16){
+		pack_slots<W>(reinterpret_cast<const char*>(src), dst, count);
+	}
+	else {
+		pack_strided(src, dst, count, stride, std::integral_constant<size_t, 0>{});
+	}
+}
+template<typename T>
+void unpack_strided(const char *src, T *dst, size_t count, size_t stride, std::integral_constant<size_t, 0>){
+	for (size_t i = 0; i < count; ++i){
+		std::memcpy(dst + i, src + stride * i, sizeof(T));
+	}
+}
+template<typename T, size_t W>
+void unpack_strided(const char *src, T *dst, size_t count, size_t stride, std::integral_constant<size_t, W>){
+	if (stride == 16){
+		unpack_slots<W>(src, reinterpret_cast<char*>(dst), count);
+	}
+	else {
+		unpack_strided(src, dst, count, stride, std::integral_constant<size_t, 0>{});
+	}
+}
+/*
+ * Write count elements from src into an array with the stride passed starting at dst
+ */
+template<typename T>
+void pack_array(const T *src, char *dst, size_t count, size_t stride){
+	if (stride == sizeof(T)){
+		std::memcpy(dst, src, count * sizeof(T));
+	}
+	else {
+		pack_strided(src, dst, count, stride, std::integral_constant<size_t, PackWidth<T>::value>{});
+	}
+}
+/*
+ * Read count elements from an array with the stride passed starting at src into dst
+ */
+template<typename T>
+void unpack_array(const char *src, T *dst, size_t count, size_t stride){
+	if (stride == sizeof(T)){
+		std::memcpy(dst, src, count * sizeof(T));
+	}
+	else {
+		unpack_strided(src, dst, count, stride, std::integral_constant<size_t, PackWidth<T>::value>{});
+	}
+}
+}
+
+#endif
+
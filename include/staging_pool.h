@@ -0,0 +1,75 @@
+#ifndef STAGING_POOL_H
+#define STAGING_POOL_H
+
+#include <vector>
+#include "gl_core_4_4.h"
+
+/*
+ * A block of staging memory handed out by the StagingPool for the CPU
+ * to write into. ptr is persistently mapped and coherent so no flush
+ * is needed before submitting it
+ */
+struct StagingBlock {
+	GLuint buffer;
+	size_t size, index;
+	char *ptr;
+
+	StagingBlock() : buffer(0), size(0), index(0), ptr(nullptr){}
+};
+
+/*
+ * A pool of persistently mapped staging buffers for large uploads. CPU writers fill
+ * a block acquired from the pool which is then copied into the destination buffer
+ * with glCopyBufferSubData, so the copy is queued behind rendering of the previous
+ * frame instead of stalling the CPU on a map of the destination. Each staging buffer
+ * is fenced after its copy and recycled once the GPU has passed the fence
+ */
+class StagingPool {
+	struct Staging {
+		GLuint buffer;
+		size_t size;
+		char *ptr;
+		GLsync fence;
+		bool in_use;
+	};
+	std::vector<Staging> buffers;
+	size_t min_size;
+
+public:
+	/*
+	 * Create a staging pool, staging buffers will be at least min_size bytes
+	 */
+	StagingPool(size_t min_size = 1 << 20);
+	~StagingPool();
+	StagingPool(const StagingPool&) = delete;
+	StagingPool& operator=(const StagingPool&) = delete;
+	/*
+	 * Get a block of at least size bytes to write into. A staging buffer the GPU
+	 * is done copying from is re-used if one is large enough, otherwise a new
+	 * one is created
+	 */
+	StagingBlock acquire(size_t size);
+	/*
+	 * Copy bytes written to the block into the buffer dst starting at dst_offset
+	 * The block should not be written to after being submitted
+	 */
+	void submit(const StagingBlock &block, GLuint dst, size_t dst_offset, size_t bytes);
+	/*
+	 * Get the number of staging buffers the pool has created
+	 */
+	size_t buffer_count() const;
+	/*
+	 * Get the number of staging buffers in use, either being written by the CPU
+	 * or waiting on the GPU to finish copying from them
+	 */
+	size_t pending() const;
+
+private:
+	/*
+	 * Check if the GPU has finished copying from a submitted staging buffer,
+	 * releasing it back to the pool if so
+	 */
+	bool try_recycle(Staging &s);
+};
+
+#endif
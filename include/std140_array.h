@@ -1,9 +1,11 @@
 #ifndef STD140_ARRAY_H
 #define STD140_ARRAY_H
 
+#include <cassert>
 #include <array>
 #include <type_traits>
 #include <glm/glm.hpp>
+#include "simd_pack.h"
 
 template<typename T, size_t N>
 class STD140Array {
@@ -43,6 +45,21 @@ public:
 	void write(size_t i, const T &t){
 		operator[](i) = t;
 	}
+	/*
+	 * Write count elements from src into the array starting at index start,
+	 * padded elements are packed into their slots with SIMD shuffles
+	 */
+	void write_range(size_t start, const T *src, size_t count){
+		assert(start + count <= N);
+		detail::pack_array(src, data + stride() * start, count, stride());
+	}
+	/*
+	 * Read count elements starting at index start into dst
+	 */
+	void read_range(size_t start, T *dst, size_t count) const {
+		assert(start + count <= N);
+		detail::unpack_array(data + stride() * start, dst, count, stride());
+	}
 	char* raw(){
 		return &data[0];
 	}
@@ -76,6 +93,17 @@ public:
 		array[2 * i] = m[0];
 		array[2 * i + 1] = m[1];
 	}
+	/*
+	 * Write count matrices from src starting at index start, converting their
+	 * columns to the padded layout together
+	 */
+	void write_range(size_t start, const glm::mat2 *src, size_t count){
+		static_assert(sizeof(glm::mat2) == 2 * sizeof(glm::vec2), "mat2 columns must be contiguous");
+		array.write_range(2 * start, reinterpret_cast<const glm::vec2*>(src), 2 * count);
+	}
+	void read_range(size_t start, glm::mat2 *dst, size_t count) const {
+		array.read_range(2 * start, reinterpret_cast<glm::vec2*>(dst), 2 * count);
+	}
 	char* raw(){
 		return array.raw();
 	}
@@ -110,6 +138,17 @@ public:
 		array[3 * i + 1] = m[1];
 		array[3 * i + 2] = m[2];
 	}
+	/*
+	 * Write count matrices from src starting at index start, converting their
+	 * columns to the padded layout together
+	 */
+	void write_range(size_t start, const glm::mat3 *src, size_t count){
+		static_assert(sizeof(glm::mat3) == 3 * sizeof(glm::vec3), "mat3 columns must be contiguous");
+		array.write_range(3 * start, reinterpret_cast<const glm::vec3*>(src), 3 * count);
+	}
+	void read_range(size_t start, glm::mat3 *dst, size_t count) const {
+		array.read_range(3 * start, reinterpret_cast<glm::vec3*>(dst), 3 * count);
+	}
 	char* raw(){
 		return array.raw();
 	}
@@ -0,0 +1,176 @@
+#ifndef STD430_ARRAY_H
+#define STD430_ARRAY_H
+
+#include <cassert>
+#include <array>
+#include <type_traits>
+#include <glm/glm.hpp>
+#include "simd_pack.h"
+
+template<typename T, size_t N>
+class STD430Array;
+
+namespace detail {
+/*
+ * Base alignment of a type under the std430 layout rules. These match
+ * std140 except that arrays and structs are no longer rounded up to
+ * the alignment of a vec4
+ */
+template<typename T>
+struct STD430Alignment {
+	//Rule 1 for scalars, anything not caught by our specializations
+	//is treated as a scalar
+	static constexpr size_t value = sizeof(T);
+};
+template<>
+struct STD430Alignment<glm::vec2> {
+	//Rule 2 for 2 component vector
+	static constexpr size_t value = 2 * sizeof(glm::vec2::value_type);
+};
+template<>
+struct STD430Alignment<glm::vec3> {
+	//Rule 3 for 3 component vector
+	static constexpr size_t value = 4 * sizeof(glm::vec3::value_type);
+};
+template<>
+struct STD430Alignment<glm::vec4> {
+	//Rule 2 for 4 component vector
+	static constexpr size_t value = 4 * sizeof(glm::vec4::value_type);
+};
+template<>
+struct STD430Alignment<glm::mat2> {
+	//Rule 5 for matrices, aligned like an array of its column vectors
+	static constexpr size_t value = STD430Alignment<glm::mat2::col_type>::value;
+};
+template<>
+struct STD430Alignment<glm::mat3> {
+	static constexpr size_t value = STD430Alignment<glm::mat3::col_type>::value;
+};
+template<>
+struct STD430Alignment<glm::mat4> {
+	static constexpr size_t value = STD430Alignment<glm::mat4::col_type>::value;
+};
+template<typename T, size_t N>
+struct STD430Alignment<STD430Array<T, N>> {
+	//Rule 4 for arrays, aligned like the element type without rounding to vec4
+	static constexpr size_t value = STD430Alignment<T>::value;
+};
+}
+
+/*
+ * An array stored following the std430 layout. Unlike std140 the array stride
+ * is only rounded up to the alignment of the element type so arrays of scalars,
+ * vec2 and mat2 are tightly packed, while vec3 and mat3 columns are still
+ * padded out to vec4
+ */
+template<typename T, size_t N>
+class STD430Array {
+	static_assert(!std::is_array<T>::value, "Multidimensional arrays not supported");
+
+public:
+	/*
+	 * Compute the array stride for the std430 layout requirements
+	 * which requires that elements are aligned to the base alignment of T
+	 */
+	static constexpr size_t stride(){
+		return sizeof(T) % detail::STD430Alignment<T>::value == 0 ? sizeof(T)
+			: sizeof(T) + detail::STD430Alignment<T>::value - sizeof(T) % detail::STD430Alignment<T>::value;
+	}
+
+private:
+	char data[N * stride()];
+
+public:
+	T& operator[](size_t i){
+		assert(i < N);
+		T *t = reinterpret_cast<T*>(data + stride() * i);
+		return *t;
+	}
+	const T& operator[](size_t i) const {
+		assert(i < N);
+		const T *t = reinterpret_cast<const T*>(data + stride() * i);
+		return *t;
+	}
+	T read(size_t i){
+		return operator[](i);
+	}
+	const T read(size_t i) const {
+		return operator[](i);
+	}
+	void write(size_t i, const T &t){
+		operator[](i) = t;
+	}
+	/*
+	 * Write count elements from src into the array starting at index start,
+	 * padded elements are packed into their slots with SIMD shuffles
+	 */
+	void write_range(size_t start, const T *src, size_t count){
+		assert(start + count <= N);
+		detail::pack_array(src, data + stride() * start, count, stride());
+	}
+	/*
+	 * Read count elements starting at index start into dst
+	 */
+	void read_range(size_t start, T *dst, size_t count) const {
+		assert(start + count <= N);
+		detail::unpack_array(data + stride() * start, dst, count, stride());
+	}
+	char* raw(){
+		return &data[0];
+	}
+	static constexpr size_t size(){
+		return N;
+	}
+};
+/*
+ * mat3 columns are vec3s which are still padded to vec4 in std430 so we need
+ * to convert between the padded and GLM's unpadded storage. mat2 and mat4 don't
+ * need this since their columns are already tightly packed
+ */
+template<size_t N>
+class STD430Array<glm::mat3, N> {
+	STD430Array<glm::vec3, 3 * N> array;
+
+public:
+	glm::mat3 read(size_t i){
+		glm::mat3 m;
+		m[0] = array[3 * i];
+		m[1] = array[3 * i + 1];
+		m[2] = array[3 * i + 2];
+		return m;
+	}
+	const glm::mat3 read(size_t i) const {
+		glm::mat3 m;
+		m[0] = array[3 * i];
+		m[1] = array[3 * i + 1];
+		m[2] = array[3 * i + 2];
+		return m;
+	}
+	void write(size_t i, const glm::mat3 &m){
+		array[3 * i] = m[0];
+		array[3 * i + 1] = m[1];
+		array[3 * i + 2] = m[2];
+	}
+	/*
+	 * Write count matrices from src starting at index start, converting their
+	 * columns to the padded layout together
+	 */
+	void write_range(size_t start, const glm::mat3 *src, size_t count){
+		static_assert(sizeof(glm::mat3) == 3 * sizeof(glm::vec3), "mat3 columns must be contiguous");
+		array.write_range(3 * start, reinterpret_cast<const glm::vec3*>(src), 3 * count);
+	}
+	void read_range(size_t start, glm::mat3 *dst, size_t count) const {
+		array.read_range(3 * start, reinterpret_cast<glm::vec3*>(dst), 3 * count);
+	}
+	char* raw(){
+		return array.raw();
+	}
+	static constexpr size_t size(){
+		return N;
+	}
+	static constexpr size_t stride(){
+		return 3 * STD430Array<glm::vec3, 3 * N>::stride();
+	}
+};
+
+#endif
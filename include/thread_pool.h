@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * A fixed pool of worker threads for splitting a loop over jobs. The thread calling
+ * run works on the jobs as well, so a pool of size n starts n - 1 workers and a pool
+ * of size 1 just runs everything on the caller
+ */
+class ThreadPool {
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable work_cv, done_cv;
+	//The job being run and the next index to hand out. Every worker takes part in each
+	//run so run can't return while a worker might still be reading the job
+	const std::function<void(size_t)> *job;
+	size_t job_count, generation, finished;
+	std::atomic<size_t> next_job;
+	bool quit;
+
+public:
+	/*
+	 * Create a pool running jobs on threads threads including the caller,
+	 * if threads is 0 one is used per hardware thread
+	 */
+	ThreadPool(size_t threads = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	/*
+	 * Get the number of threads running jobs, including the caller
+	 */
+	size_t size() const;
+	/*
+	 * Call f(i) for each i in [0, count) spread over the pool's threads,
+	 * returns once all the calls have finished
+	 */
+	void run(size_t count, const std::function<void(size_t)> &f);
+
+private:
+	void worker_loop();
+	/*
+	 * Take jobs from the current run until there are none left
+	 */
+	void work(const std::function<void(size_t)> &f, size_t count);
+};
+
+#endif
+
@@ -0,0 +1,58 @@
+#ifndef UPLOAD_STRATEGY_H
+#define UPLOAD_STRATEGY_H
+
+#include <cstddef>
+#include "gl_core_4_4.h"
+
+/*
+ * Strategies a buffer can use to avoid stalling when mapping it for writing
+ * while the GPU may still be reading from it
+ * DEFAULT: Map with the flags given and let the driver synchronize
+ * ORPHAN: Re-specify the buffer storage before mapping so the driver can hand us
+ *         fresh memory, any data outside the mapped range is refilled from the
+ *         shadow copy if there is one, otherwise this falls back to INVALIDATE
+ * INVALIDATE: Map with GL_MAP_INVALIDATE_RANGE_BIT so the old contents of the
+ *             range don't need to be preserved
+ * UNSYNCHRONIZED: Map with GL_MAP_UNSYNCHRONIZED_BIT, waiting only on the fences
+ *                 placed with fence() over ranges overlapping the one being mapped
+ */
+enum class UploadStrategy { DEFAULT, ORPHAN, INVALIDATE, UNSYNCHRONIZED };
+const size_t NUM_UPLOAD_STRATEGIES = 4;
+
+/*
+ * Timing information about how long maps of a buffer have blocked
+ */
+struct MapStats {
+	size_t maps;
+	double total_ms, max_ms;
+
+	MapStats() : maps(0), total_ms(0), max_ms(0){}
+	double average_ms() const {
+		return maps == 0 ? 0 : total_ms / maps;
+	}
+};
+
+/*
+ * A fence placed after GPU commands reading from the byte range [start, end) of a buffer
+ */
+struct RangeFence {
+	size_t start, end;
+	GLsync sync;
+
+	RangeFence(size_t start, size_t end, GLsync sync) : start(start), end(end), sync(sync){}
+};
+
+inline const char* upload_strategy_name(UploadStrategy s){
+	switch (s){
+		case UploadStrategy::ORPHAN:
+			return "orphan";
+		case UploadStrategy::INVALIDATE:
+			return "invalidate";
+		case UploadStrategy::UNSYNCHRONIZED:
+			return "unsynchronized";
+		default:
+			return "default";
+	}
+}
+
+#endif
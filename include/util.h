@@ -7,6 +7,7 @@
 #include <glm/glm.hpp>
 #include "gl_core_4_4.h"
 #include "interleavedbuffer.h"
+#include "frustum.h"
 
 namespace util {
 #ifdef _WIN32
@@ -32,9 +33,12 @@ namespace util {
 	 */
 	GLint load_shader(GLenum type, const std::string &file);
 	/*
-	 * Build a shader program from the list of shaders passed
+	 * Build a shader program from the list of shaders passed. The shared files are
+	 * compiled again for each stage in the list and linked in, so shaders can call
+	 * functions defined in them after declaring their prototypes
 	 */
-	GLint load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders);
+	GLint load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders,
+		const std::vector<std::string> &shared = {});
 	/*
 	 * Load an image into a 2D texture, creating a new texture id
 	 * The texture unit desired for this texture should be set active
@@ -54,6 +58,11 @@ namespace util {
 	 * and height of the loaded image
 	 */
 	GLuint load_texture_array(const std::vector<std::string> &files, size_t *w = nullptr, size_t *h = nullptr);
+	/*
+	 * Delete a texture loaded by load_texture or load_texture_array, removing
+	 * its memory from the gpu_memory registry
+	 */
+	void delete_texture(GLuint tex);
 	/*
 	 * Check for an OpenGL error and log it along with the message passed
 	 * if an error occured. Will return true if an error occured & was logged
@@ -75,13 +84,15 @@ namespace util {
 	* n_verts: optional out parameter to get the number of vertices written to the vbo passed
 	* vert_offset: optionally specify the index in the vbo to start writing the model
 	* elem_offset: optionally specify the index in the ebo to start writing model indices
+	* staging: optionally upload the model through a staging pool instead of mapping the buffers
+	* bounds: optional out parameter to get the model space bounds of the model
 	* The vbo elems are: vec3 pos, vec3 normal, vec3 uv
 	* returns true on success, false on failure
 	* TODO: Take any buffer layout?
 	*/
 	bool load_obj(const std::string &fname, PackedBuffer<glm::vec3, glm::vec3, glm::vec3> &vbo,
 		PackedBuffer<GLushort> &ebo, size_t &n_elems, size_t *n_verts = nullptr,
-		size_t vert_offset = 0, size_t elem_offset = 0);
+		size_t vert_offset = 0, size_t elem_offset = 0, StagingPool *staging = nullptr, AABB *bounds = nullptr);
 	/*
 	* Functions to get values from formatted strings, for use in reading the
 	* model file
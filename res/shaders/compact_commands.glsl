@@ -0,0 +1,32 @@
+#version 440 core
+
+//Packs the draw commands of the models with visible instances left by cull_instances
+//to the front of the draw buffer and writes how many there are to the parameter buffer,
+//for drawing with glMultiDrawElementsIndirectCountARB. There's only a command per model
+//so a single invocation walks them in order
+
+layout(local_size_x = 1) in;
+
+struct DrawCommand {
+	uint count, instance_count, first_index, base_vertex, base_instance;
+};
+
+layout(std430, binding = 3) readonly buffer CulledCommands {
+	DrawCommand culled_commands[];
+};
+layout(std430, binding = 5) writeonly buffer DrawCommands {
+	DrawCommand draw_commands[];
+};
+layout(std430, binding = 6) writeonly buffer DrawCount {
+	uint draw_count;
+};
+
+void main(void){
+	uint n = 0;
+	for (uint i = 0; i < culled_commands.length(); ++i){
+		if (culled_commands[i].instance_count != 0){
+			draw_commands[n++] = culled_commands[i];
+		}
+	}
+	draw_count = n;
+}
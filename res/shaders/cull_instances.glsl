@@ -0,0 +1,145 @@
+#version 440 core
+
+//Culls the instances of a MultiRenderBatch against the view frustum. Each visible
+//instance's attributes are copied to the next free spot at the start of its model's
+//batch in the culled buffer and counted into the model's culled draw command.
+//Instances inside the frustum can also be tested against a DepthPyramid of occluders.
+//Dispatch with the work group's y index selecting the model
+
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+	uint count, instance_count, first_index, base_vertex, base_instance;
+};
+struct ModelBounds {
+	vec4 center, extent;
+};
+
+//The instance attributes are read and copied as words since their layout depends on the batch
+layout(std430, binding = 0) readonly buffer Instances {
+	uint instances[];
+};
+layout(std430, binding = 1) writeonly buffer CulledInstances {
+	uint culled_instances[];
+};
+//The batch's draw commands giving the offset and number of instances of each model
+layout(std430, binding = 2) readonly buffer Commands {
+	DrawCommand commands[];
+};
+//The draw commands rendering the culled instances, instance_count must be zeroed before culling
+layout(std430, binding = 3) buffer CulledCommands {
+	DrawCommand culled_commands[];
+};
+//The model space bounds of each model
+layout(std430, binding = 4) readonly buffer Bounds {
+	ModelBounds bounds[];
+};
+
+//Frustum planes with normals pointing into the frustum
+uniform vec4 planes[6];
+//Size of an instance's attributes and the offset of its transform within them in words
+uniform uint instance_stride;
+uniform uint transform_offset;
+//How the transform is stored, 0 for a mat4 and 1 for a GridTransform
+uniform uint transform_format;
+//The depth pyramid of occluders and the view-projection they were drawn with, occlusion
+//culling is skipped if hiz_levels is 0
+layout(binding = 0) uniform sampler2D hiz;
+uniform int hiz_levels;
+uniform mat4 hiz_view_proj;
+
+//Decode a GridTransform, defined in grid_transform.glsl
+mat4 grid_transform(ivec4 g);
+
+mat4 load_transform(uint start){
+	if (transform_format == 1){
+		//The four shorts are packed two to a word, low half first
+		const int lo = int(instances[start]);
+		const int hi = int(instances[start + 1]);
+		return grid_transform(ivec4(bitfieldExtract(lo, 0, 16), bitfieldExtract(lo, 16, 16),
+			bitfieldExtract(hi, 0, 16), bitfieldExtract(hi, 16, 16)));
+	}
+	mat4 m;
+	for (int c = 0; c < 4; ++c){
+		for (int r = 0; r < 4; ++r){
+			m[c][r] = uintBitsToFloat(instances[start + 4 * c + r]);
+		}
+	}
+	return m;
+}
+
+//Check if the world space box is behind the occluders in the depth pyramid
+bool occluded(vec3 c, vec3 e){
+	vec3 ndc_min = vec3(1);
+	vec3 ndc_max = vec3(-1);
+	for (int i = 0; i < 8; ++i){
+		const vec3 corner = c + e * vec3((i & 1) != 0 ? 1 : -1, (i & 2) != 0 ? 1 : -1, (i & 4) != 0 ? 1 : -1);
+		const vec4 p = hiz_view_proj * vec4(corner, 1);
+		//Boxes crossing the near plane can't be projected, just treat them as visible
+		if (p.w <= 0){
+			return false;
+		}
+		ndc_min = min(ndc_min, p.xyz / p.w);
+		ndc_max = max(ndc_max, p.xyz / p.w);
+	}
+	//The pyramid only knows the occluders on screen, so boxes reaching off screen may be
+	//visible past its edges. Clamping them to the screen would test only part of the box
+	if (any(lessThan(ndc_min.xy, vec2(-1))) || any(greaterThan(ndc_max.xy, vec2(1)))){
+		return false;
+	}
+	const vec2 uv_min = ndc_min.xy * 0.5 + 0.5;
+	const vec2 uv_max = ndc_max.xy * 0.5 + 0.5;
+	const float box_depth = ndc_min.z * 0.5 + 0.5;
+
+	//Pick the level where the box covers at most 2x2 texels and take the farthest of them
+	const vec2 texels = (uv_max - uv_min) * vec2(textureSize(hiz, 0));
+	int level = clamp(int(ceil(log2(max(max(texels.x, texels.y), 1)))), 0, hiz_levels - 1);
+	ivec2 size = textureSize(hiz, level);
+	ivec2 lo = min(ivec2(uv_min * size), size - 1);
+	ivec2 hi = min(ivec2(uv_max * size), size - 1);
+	if (any(greaterThan(hi - lo, ivec2(1))) && level < hiz_levels - 1){
+		++level;
+		size = textureSize(hiz, level);
+		lo = min(ivec2(uv_min * size), size - 1);
+		hi = min(ivec2(uv_max * size), size - 1);
+	}
+	if (any(greaterThan(hi - lo, ivec2(1)))){
+		return false;
+	}
+	float depth = 0;
+	for (int y = lo.y; y <= hi.y; ++y){
+		for (int x = lo.x; x <= hi.x; ++x){
+			depth = max(depth, texelFetch(hiz, ivec2(x, y), level).r);
+		}
+	}
+	return box_depth > depth;
+}
+
+void main(void){
+	const uint model = gl_WorkGroupID.y;
+	const uint i = gl_GlobalInvocationID.x;
+	if (i >= commands[model].instance_count){
+		return;
+	}
+	const uint src = (commands[model].base_instance + i) * instance_stride;
+	const mat4 m = load_transform(src + transform_offset);
+
+	//Find the world space bounds of the instance and test them against each plane
+	const vec3 c = (m * vec4(bounds[model].center.xyz, 1)).xyz;
+	const vec3 e = bounds[model].extent.xyz;
+	const vec3 we = abs(m[0].xyz) * e.x + abs(m[1].xyz) * e.y + abs(m[2].xyz) * e.z;
+	for (int p = 0; p < 6; ++p){
+		if (dot(planes[p].xyz, c) + planes[p].w < -dot(abs(planes[p].xyz), we)){
+			return;
+		}
+	}
+	if (hiz_levels > 0 && occluded(c, we)){
+		return;
+	}
+
+	const uint slot = atomicAdd(culled_commands[model].instance_count, 1);
+	const uint dst = (culled_commands[model].base_instance + slot) * instance_stride;
+	for (uint w = 0; w < instance_stride; ++w){
+		culled_instances[dst + w] = instances[src + w];
+	}
+}
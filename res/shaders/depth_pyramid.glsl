@@ -0,0 +1,30 @@
+#version 440 core
+
+//Builds a level of a DepthPyramid from the level above it, or the depth buffer
+//for level 0. Each texel gets the farthest depth of the source texels it covers
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+//The source is limited to the single level being read
+layout(binding = 0) uniform sampler2D src;
+layout(r32f, binding = 0) writeonly uniform image2D dst;
+
+void main(void){
+	const ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+	const ivec2 dst_size = imageSize(dst);
+	if (any(greaterThanEqual(p, dst_size))){
+		return;
+	}
+	//Odd sized sources have texels covered by two destination texels, include
+	//them in both so we never under estimate the depth
+	const ivec2 src_size = textureSize(src, 0);
+	const ivec2 lo = p * src_size / dst_size;
+	const ivec2 hi = max(lo + 1, ((p + 1) * src_size + dst_size - 1) / dst_size);
+	float depth = 0;
+	for (int y = lo.y; y < hi.y; ++y){
+		for (int x = lo.x; x < hi.x; ++x){
+			depth = max(depth, texelFetch(src, ivec2(x, y), 0).r);
+		}
+	}
+	imageStore(dst, p, vec4(depth));
+}
@@ -1,10 +1,17 @@
 #version 440 core
 
+layout(binding = 1) uniform sampler2DArray tile_textures;
+
 in vec3 fcolor;
+in vec3 fnormal;
+in vec2 fuv;
+flat in uint flayer;
 
 out vec4 color;
 
 void main(void){
-	color = vec4(fcolor, 1);
+	//Tint the instance's texture by its color and shade with a fixed light from above
+	const vec3 light_dir = normalize(vec3(0.3, 1, 0.5));
+	const float diffuse = 0.4 + 0.6 * max(dot(normalize(fnormal), light_dir), 0);
+	color = vec4(texture(tile_textures, vec3(fuv, flayer)).rgb * fcolor * diffuse, 1);
 }
-
@@ -0,0 +1,20 @@
+#version 440 core
+
+//Decoding of GridTransform instance attributes, shared between the shaders reading them.
+//It's compiled and linked into a program for each stage that declares the prototype:
+//mat4 grid_transform(ivec4 g);
+
+//Decode a GridTransform, matching GridTransform::unpack
+const ivec3 grid_axes[6] = ivec3[6](ivec3(0, 1, 2), ivec3(0, 2, 1), ivec3(1, 0, 2),
+	ivec3(1, 2, 0), ivec3(2, 0, 1), ivec3(2, 1, 0));
+mat4 grid_transform(ivec4 g){
+	const int code = g.w & 0xffff;
+	const ivec3 axes = grid_axes[min(code & 7, 5)];
+	const float s = float(code >> 8) / 16;
+	mat4 m = mat4(0);
+	for (int c = 0; c < 3; ++c){
+		m[c][axes[c]] = ((code >> (3 + c)) & 1) != 0 ? -s : s;
+	}
+	m[3] = vec4(g.xyz, 1);
+	return m;
+}
@@ -0,0 +1,45 @@
+#version 440 core
+#extension GL_ARB_shader_draw_parameters : require
+
+//The glMultiDrawElementsIndirect test shader reading the instances from a storage buffer
+//instead of attributes, indexed by the draw's base instance and the instance within it
+
+layout(std140) uniform Viewing {
+	mat4 view, proj;
+};
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+
+//A tile instance in the batch's packed layout, an RGBA8 color, a GridTransform
+//as two words of shorts and the layer of the tile texture array
+struct Instance {
+	uint color;
+	uint grid_xy, grid_z_code;
+	uint layer;
+};
+layout(std430, binding = 0) readonly buffer Instances {
+	Instance instances[];
+};
+
+//Decode a GridTransform, defined in grid_transform.glsl
+mat4 grid_transform(ivec4 g);
+
+out vec3 fcolor;
+out vec3 fnormal;
+out vec2 fuv;
+flat out uint flayer;
+
+void main(void){
+	const Instance inst = instances[gl_BaseInstanceARB + gl_InstanceID];
+	const int xy = int(inst.grid_xy);
+	const int z_code = int(inst.grid_z_code);
+	const mat4 model = grid_transform(ivec4(bitfieldExtract(xy, 0, 16), bitfieldExtract(xy, 16, 16),
+		bitfieldExtract(z_code, 0, 16), bitfieldExtract(z_code, 16, 16)));
+	fcolor = unpackUnorm4x8(inst.color).rgb;
+	fnormal = mat3(model) * normal;
+	fuv = uv;
+	flayer = inst.layer;
+	gl_Position = proj * view * model * vec4(pos, 1);
+}
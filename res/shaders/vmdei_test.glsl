@@ -8,13 +8,26 @@ layout(std140) uniform Viewing {
 
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 normal;
-layout(location = 2) in vec3 color;
-layout(location = 3) in mat4 model;
+layout(location = 2) in vec2 uv;
+layout(location = 3) in vec3 color;
+//The instance's GridTransform, its code is sign extended when read and masked back off
+layout(location = 4) in ivec4 grid;
+//The layer of the tile texture array the instance is textured with
+layout(location = 5) in uint layer;
+
+//Decode a GridTransform, defined in grid_transform.glsl
+mat4 grid_transform(ivec4 g);
 
 out vec3 fcolor;
+out vec3 fnormal;
+out vec2 fuv;
+flat out uint flayer;
 
 void main(void){
-	fcolor = color + 0.5 * normal;
+	const mat4 model = grid_transform(grid);
+	fcolor = color;
+	fnormal = mat3(model) * normal;
+	fuv = uv;
+	flayer = layer;
 	gl_Position = proj * view * model * vec4(pos, 1);
 }
-
@@ -0,0 +1,115 @@
+#include <cassert>
+#include <algorithm>
+#include "gl_core_4_4.h"
+#include "gl_caps.h"
+#include "gpu_memory.h"
+#include "buffer_arena.h"
+
+BufferArena::BufferArena(size_t page_size, GLenum usage, size_t alignment)
+	: page_size(page_size), alignment(alignment), usage(usage)
+{
+	if (alignment == 0){
+		GLint ubo_align = 0, ssbo_align = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_align);
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_align);
+		this->alignment = std::max<size_t>(16, std::max(ubo_align, ssbo_align));
+	}
+}
+BufferArena::~BufferArena(){
+	for (auto &p : pages){
+		glDeleteBuffers(1, &p.buffer);
+		gpu_memory::track_free(MemCategory::ARENA, p.size);
+	}
+}
+ArenaRange BufferArena::alloc(size_t size){
+	assert(size > 0);
+	//Round up so the range after this one stays aligned
+	size = size % alignment == 0 ? size : size + alignment - size % alignment;
+	ArenaRange range;
+	for (size_t i = 0; i < pages.size(); ++i){
+		if (alloc_from(i, size, range)){
+			return range;
+		}
+	}
+	size_t page = add_page(size);
+	bool ok = alloc_from(page, size, range);
+	assert(ok);
+	(void)ok;
+	return range;
+}
+void BufferArena::release(const ArenaRange &range){
+	if (range.size == 0){
+		return;
+	}
+	assert(range.page < pages.size() && pages[range.page].buffer == range.buffer);
+	auto &free_list = pages[range.page].free_list;
+	auto it = free_list.insert(std::make_pair(range.offset, range.size)).first;
+	//Merge with the following free block
+	auto next = std::next(it);
+	if (next != free_list.end() && it->first + it->second == next->first){
+		it->second += next->second;
+		free_list.erase(next);
+	}
+	//Merge with the preceding free block
+	if (it != free_list.begin()){
+		auto prev = std::prev(it);
+		if (prev->first + prev->second == it->first){
+			prev->second += it->second;
+			free_list.erase(it);
+		}
+	}
+}
+size_t BufferArena::page_count() const {
+	return pages.size();
+}
+size_t BufferArena::bytes_used() const {
+	size_t used = 0;
+	for (const auto &p : pages){
+		used += p.size;
+		for (const auto &f : p.free_list){
+			used -= f.second;
+		}
+	}
+	return used;
+}
+size_t BufferArena::range_alignment() const {
+	return alignment;
+}
+size_t BufferArena::add_page(size_t size){
+	Page p;
+	p.size = std::max(size, page_size);
+	p.free_list[0] = p.size;
+	//Pages are never resized so with DSA we can give them immutable storage
+	if (util::has_dsa()){
+		glCreateBuffers(1, &p.buffer);
+		glNamedBufferStorage(p.buffer, p.size, NULL, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+	}
+	else {
+		glGenBuffers(1, &p.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, p.buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, p.size, NULL, usage);
+	}
+	gpu_memory::track_alloc(MemCategory::ARENA, p.size);
+	pages.push_back(p);
+	return pages.size() - 1;
+}
+bool BufferArena::alloc_from(size_t page, size_t size, ArenaRange &range){
+	auto &free_list = pages[page].free_list;
+	//First fit, block offsets and sizes are kept aligned so no padding is needed
+	auto it = std::find_if(free_list.begin(), free_list.end(),
+		[size](const std::pair<const size_t, size_t> &f){
+			return f.second >= size;
+		});
+	if (it == free_list.end()){
+		return false;
+	}
+	range.buffer = pages[page].buffer;
+	range.offset = it->first;
+	range.size = size;
+	range.page = page;
+	if (it->second > size){
+		free_list[it->first + size] = it->second - size;
+	}
+	free_list.erase(it);
+	return true;
+}
@@ -0,0 +1,82 @@
+#include <cstring>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "frustum.h"
+#include "cpu_cull.h"
+#include "simd.h"
+
+size_t BoundsSoA::size() const {
+	return cx.size();
+}
+void BoundsSoA::resize(size_t n){
+	for (auto *v : {&cx, &cy, &cz, &ex, &ey, &ez}){
+		v->resize(n, 0.f);
+	}
+}
+void BoundsSoA::set(size_t i, const AABB &box){
+	const glm::vec3 c = box.center();
+	const glm::vec3 e = box.extent();
+	cx[i] = c.x;
+	cy[i] = c.y;
+	cz[i] = c.z;
+	ex[i] = e.x;
+	ey[i] = e.y;
+	ez[i] = e.z;
+}
+void BoundsSoA::move(size_t src, size_t dst, size_t count){
+	for (auto *v : {&cx, &cy, &cz, &ex, &ey, &ez}){
+		std::memmove(v->data() + dst, v->data() + src, count * sizeof(float));
+	}
+}
+size_t cpu_cull::cull_bounds(const Frustum &frustum, const BoundsSoA &bounds, size_t begin, size_t end,
+	uint32_t *visible)
+{
+	size_t n_visible = 0;
+	size_t i = begin;
+#ifdef HAS_SSE
+	//Test 4 boxes at a time, a box is outside if it's entirely behind any plane
+	__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; ++p){
+		const glm::vec4 &pl = frustum.plane(p);
+		nx[p] = _mm_set1_ps(pl.x);
+		ny[p] = _mm_set1_ps(pl.y);
+		nz[p] = _mm_set1_ps(pl.z);
+		nw[p] = _mm_set1_ps(pl.w);
+		ax[p] = _mm_set1_ps(std::abs(pl.x));
+		ay[p] = _mm_set1_ps(std::abs(pl.y));
+		az[p] = _mm_set1_ps(std::abs(pl.z));
+	}
+	const size_t whole = end - (end - begin) % 4;
+	for (; i < whole; i += 4){
+		const __m128 cx = _mm_loadu_ps(&bounds.cx[i]);
+		const __m128 cy = _mm_loadu_ps(&bounds.cy[i]);
+		const __m128 cz = _mm_loadu_ps(&bounds.cz[i]);
+		const __m128 ex = _mm_loadu_ps(&bounds.ex[i]);
+		const __m128 ey = _mm_loadu_ps(&bounds.ey[i]);
+		const __m128 ez = _mm_loadu_ps(&bounds.ez[i]);
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; ++p){
+			const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+				_mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+			const __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+				_mm_mul_ps(az[p], ez));
+			//d < -r  <=>  d + r < 0
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+		}
+		const int inside = ~_mm_movemask_ps(outside) & 0xf;
+		for (int b = 0; b < 4; ++b){
+			if (inside & (1 << b)){
+				visible[n_visible++] = static_cast<uint32_t>(i + b);
+			}
+		}
+	}
+#endif
+	for (; i < end; ++i){
+		const glm::vec3 c{bounds.cx[i], bounds.cy[i], bounds.cz[i]};
+		const glm::vec3 e{bounds.ex[i], bounds.ey[i], bounds.ez[i]};
+		if (frustum.intersects(c, e)){
+			visible[n_visible++] = static_cast<uint32_t>(i);
+		}
+	}
+	return n_visible;
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "gl_core_4_4.h"
+#include "gpu_memory.h"
+#include "depth_pyramid.h"
+
+DepthPyramid::DepthPyramid(size_t width, size_t height, GLuint program)
+	: width(width), height(height), num_levels(1), fbo(0), depth_tex(0), pyramid_tex(0), program(program),
+	prev_fbo(0)
+{
+	glGenTextures(1, &depth_tex);
+	glBindTexture(GL_TEXTURE_2D, depth_tex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	gpu_memory::track_texture(depth_tex, width * height * 4);
+
+	const size_t w0 = std::max(width / 2, size_t{1});
+	const size_t h0 = std::max(height / 2, size_t{1});
+	for (size_t s = std::max(w0, h0); s > 1; s /= 2){
+		++num_levels;
+	}
+	glGenTextures(1, &pyramid_tex);
+	glBindTexture(GL_TEXTURE_2D, pyramid_tex);
+	glTexStorage2D(GL_TEXTURE_2D, num_levels, GL_R32F, w0, h0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	size_t bytes = 0;
+	for (size_t l = 0; l < num_levels; ++l){
+		bytes += std::max(w0 >> l, size_t{1}) * std::max(h0 >> l, size_t{1}) * 4;
+	}
+	gpu_memory::track_texture(pyramid_tex, bytes);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	//The texture's contents are undefined until written, so culling against it before
+	//the first end would hide instances at random
+	clear();
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth_tex, 0);
+	glDrawBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+DepthPyramid::~DepthPyramid(){
+	glDeleteFramebuffers(1, &fbo);
+	gpu_memory::release_texture(depth_tex);
+	gpu_memory::release_texture(pyramid_tex);
+	glDeleteTextures(1, &depth_tex);
+	glDeleteTextures(1, &pyramid_tex);
+}
+void DepthPyramid::begin(const glm::mat4 &view_proj){
+	occluder_view_proj = view_proj;
+	glGetIntegerv(GL_VIEWPORT, prev_viewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prev_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, width, height);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+void DepthPyramid::end(){
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+	glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+
+	GLint prev_program = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &prev_program);
+	glUseProgram(program);
+	glActiveTexture(GL_TEXTURE0);
+	//Each level is reduced from the one above it, starting from the depth buffer. While reading
+	//a level of the pyramid we limit the texture to it so the level being written isn't bound for reading
+	size_t w = std::max(width / 2, size_t{1});
+	size_t h = std::max(height / 2, size_t{1});
+	for (size_t l = 0; l < num_levels; ++l){
+		if (l == 0){
+			glBindTexture(GL_TEXTURE_2D, depth_tex);
+		}
+		else {
+			glBindTexture(GL_TEXTURE_2D, pyramid_tex);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, l - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, l - 1);
+		}
+		glBindImageTexture(0, pyramid_tex, l, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		w = std::max(w / 2, size_t{1});
+		h = std::max(h / 2, size_t{1});
+	}
+	glBindTexture(GL_TEXTURE_2D, pyramid_tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(prev_program);
+}
+void DepthPyramid::clear(){
+	occluder_view_proj = glm::mat4{1.f};
+	const float far_depth = 1.f;
+	for (size_t l = 0; l < num_levels; ++l){
+		glClearTexImage(pyramid_tex, l, GL_RED, GL_FLOAT, &far_depth);
+	}
+}
+GLuint DepthPyramid::texture() const {
+	return pyramid_tex;
+}
+size_t DepthPyramid::levels() const {
+	return num_levels;
+}
+const glm::mat4& DepthPyramid::view_proj() const {
+	return occluder_view_proj;
+}
@@ -0,0 +1,68 @@
+#include <cmath>
+#include <limits>
+#include <glm/glm.hpp>
+#include "frustum.h"
+
+AABB::AABB() : min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max()){}
+AABB::AABB(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max){}
+void AABB::expand(const glm::vec3 &p){
+	min = glm::min(min, p);
+	max = glm::max(max, p);
+}
+bool AABB::empty() const {
+	return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+glm::vec3 AABB::center() const {
+	return (min + max) * 0.5f;
+}
+glm::vec3 AABB::extent() const {
+	return (max - min) * 0.5f;
+}
+AABB AABB::transform(const glm::mat4 &m) const {
+	//Transform the center and find the extent along each world axis from
+	//the absolute values of the rotation/scale part of the matrix
+	const glm::vec3 c = center();
+	const glm::vec3 e = extent();
+	const glm::vec4 tc = m * glm::vec4{c, 1.f};
+	glm::vec3 te;
+	for (int i = 0; i < 3; ++i){
+		te[i] = std::abs(m[0][i]) * e.x + std::abs(m[1][i]) * e.y + std::abs(m[2][i]) * e.z;
+	}
+	const glm::vec3 wc{tc.x, tc.y, tc.z};
+	return AABB{wc - te, wc + te};
+}
+
+Frustum::Frustum(const glm::mat4 &view_proj){
+	//Gribb & Hartmann: the planes are sums and differences of the matrix rows, glm is column major
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i){
+		rows[i] = glm::vec4{view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]};
+	}
+	for (int i = 0; i < 3; ++i){
+		planes[2 * i] = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+	for (auto &p : planes){
+		p /= glm::length(glm::vec3{p.x, p.y, p.z});
+	}
+}
+const glm::vec4& Frustum::plane(size_t i) const {
+	return planes[i];
+}
+const std::array<glm::vec4, 6>& Frustum::all_planes() const {
+	return planes;
+}
+bool Frustum::intersects(const AABB &box) const {
+	return intersects(box.center(), box.extent());
+}
+bool Frustum::intersects(const glm::vec3 &center, const glm::vec3 &extent) const {
+	//The box is outside if it's entirely behind any plane, which is the case when the
+	//center is further behind the plane than the box's projected radius along its normal
+	for (const auto &p : planes){
+		const glm::vec3 n{p.x, p.y, p.z};
+		if (glm::dot(n, center) + p.w < -glm::dot(glm::abs(n), extent)){
+			return false;
+		}
+	}
+	return true;
+}
@@ -96,6 +96,10 @@ static PROC WinGetProcAddress(const char *name)
 #endif
 
 int ogl_ext_ARB_debug_output = ogl_LOAD_FAILED;
+int ogl_ext_ARB_direct_state_access = ogl_LOAD_FAILED;
+int ogl_ext_ARB_indirect_parameters = ogl_LOAD_FAILED;
+int ogl_ext_ARB_pipeline_statistics_query = ogl_LOAD_FAILED;
+int ogl_ext_ARB_shader_draw_parameters = ogl_LOAD_FAILED;
 
 void (CODEGEN_FUNCPTR *_ptrc_glDebugMessageCallbackARB)(GLDEBUGPROCARB, const void *) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glDebugMessageControlARB)(GLenum, GLenum, GLenum, GLsizei, const GLuint *, GLboolean) = NULL;
@@ -116,6 +120,77 @@ static int Load_ARB_debug_output()
 	return numFailed;
 }
 
+void (CODEGEN_FUNCPTR *_ptrc_glCopyNamedBufferSubData)(GLuint, GLuint, GLintptr, GLintptr, GLsizeiptr) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glCreateBuffers)(GLsizei, GLuint *) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glCreateVertexArrays)(GLsizei, GLuint *) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glEnableVertexArrayAttrib)(GLuint, GLuint) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glFlushMappedNamedBufferRange)(GLuint, GLintptr, GLsizeiptr) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glGetNamedBufferSubData)(GLuint, GLintptr, GLsizeiptr, void *) = NULL;
+void * (CODEGEN_FUNCPTR *_ptrc_glMapNamedBufferRange)(GLuint, GLintptr, GLsizeiptr, GLbitfield) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glNamedBufferData)(GLuint, GLsizeiptr, const void *, GLenum) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glNamedBufferStorage)(GLuint, GLsizeiptr, const void *, GLbitfield) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glNamedBufferSubData)(GLuint, GLintptr, GLsizeiptr, const void *) = NULL;
+GLboolean (CODEGEN_FUNCPTR *_ptrc_glUnmapNamedBuffer)(GLuint) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayAttribBinding)(GLuint, GLuint, GLuint) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayAttribFormat)(GLuint, GLuint, GLint, GLenum, GLboolean, GLuint) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayAttribIFormat)(GLuint, GLuint, GLint, GLenum, GLuint) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayBindingDivisor)(GLuint, GLuint, GLuint) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayElementBuffer)(GLuint, GLuint) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glVertexArrayVertexBuffer)(GLuint, GLuint, GLuint, GLintptr, GLsizei) = NULL;
+
+static int Load_ARB_direct_state_access()
+{
+	int numFailed = 0;
+	_ptrc_glCopyNamedBufferSubData = (void (CODEGEN_FUNCPTR *)(GLuint, GLuint, GLintptr, GLintptr, GLsizeiptr))IntGetProcAddress("glCopyNamedBufferSubData");
+	if(!_ptrc_glCopyNamedBufferSubData) numFailed++;
+	_ptrc_glCreateBuffers = (void (CODEGEN_FUNCPTR *)(GLsizei, GLuint *))IntGetProcAddress("glCreateBuffers");
+	if(!_ptrc_glCreateBuffers) numFailed++;
+	_ptrc_glCreateVertexArrays = (void (CODEGEN_FUNCPTR *)(GLsizei, GLuint *))IntGetProcAddress("glCreateVertexArrays");
+	if(!_ptrc_glCreateVertexArrays) numFailed++;
+	_ptrc_glEnableVertexArrayAttrib = (void (CODEGEN_FUNCPTR *)(GLuint, GLuint))IntGetProcAddress("glEnableVertexArrayAttrib");
+	if(!_ptrc_glEnableVertexArrayAttrib) numFailed++;
+	_ptrc_glFlushMappedNamedBufferRange = (void (CODEGEN_FUNCPTR *)(GLuint, GLintptr, GLsizeiptr))IntGetProcAddress("glFlushMappedNamedBufferRange");
+	if(!_ptrc_glFlushMappedNamedBufferRange) numFailed++;
+	_ptrc_glGetNamedBufferSubData = (void (CODEGEN_FUNCPTR *)(GLuint, GLintptr, GLsizeiptr, void *))IntGetProcAddress("glGetNamedBufferSubData");
+	if(!_ptrc_glGetNamedBufferSubData) numFailed++;
+	_ptrc_glMapNamedBufferRange = (void * (CODEGEN_FUNCPTR *)(GLuint, GLintptr, GLsizeiptr, GLbitfield))IntGetProcAddress("glMapNamedBufferRange");
+	if(!_ptrc_glMapNamedBufferRange) numFailed++;
+	_ptrc_glNamedBufferData = (void (CODEGEN_FUNCPTR *)(GLuint, GLsizeiptr, const void *, GLenum))IntGetProcAddress("glNamedBufferData");
+	if(!_ptrc_glNamedBufferData) numFailed++;
+	_ptrc_glNamedBufferStorage = (void (CODEGEN_FUNCPTR *)(GLuint, GLsizeiptr, const void *, GLbitfield))IntGetProcAddress("glNamedBufferStorage");
+	if(!_ptrc_glNamedBufferStorage) numFailed++;
+	_ptrc_glNamedBufferSubData = (void (CODEGEN_FUNCPTR *)(GLuint, GLintptr, GLsizeiptr, const void *))IntGetProcAddress("glNamedBufferSubData");
+	if(!_ptrc_glNamedBufferSubData) numFailed++;
+	_ptrc_glUnmapNamedBuffer = (GLboolean (CODEGEN_FUNCPTR *)(GLuint))IntGetProcAddress("glUnmapNamedBuffer");
+	if(!_ptrc_glUnmapNamedBuffer) numFailed++;
+	_ptrc_glVertexArrayAttribBinding = (void (CODEGEN_FUNCPTR *)(GLuint, GLuint, GLuint))IntGetProcAddress("glVertexArrayAttribBinding");
+	if(!_ptrc_glVertexArrayAttribBinding) numFailed++;
+	_ptrc_glVertexArrayAttribFormat = (void (CODEGEN_FUNCPTR *)(GLuint, GLuint, GLint, GLenum, GLboolean, GLuint))IntGetProcAddress("glVertexArrayAttribFormat");
+	if(!_ptrc_glVertexArrayAttribFormat) numFailed++;
+	_ptrc_glVertexArrayAttribIFormat = (void (CODEGEN_FUNCPTR *)(GLuint, GLuint, GLint, GLenum, GLuint))IntGetProcAddress("glVertexArrayAttribIFormat");
+	if(!_ptrc_glVertexArrayAttribIFormat) numFailed++;
+	_ptrc_glVertexArrayBindingDivisor = (void (CODEGEN_FUNCPTR *)(GLuint, GLuint, GLuint))IntGetProcAddress("glVertexArrayBindingDivisor");
+	if(!_ptrc_glVertexArrayBindingDivisor) numFailed++;
+	_ptrc_glVertexArrayElementBuffer = (void (CODEGEN_FUNCPTR *)(GLuint, GLuint))IntGetProcAddress("glVertexArrayElementBuffer");
+	if(!_ptrc_glVertexArrayElementBuffer) numFailed++;
+	_ptrc_glVertexArrayVertexBuffer = (void (CODEGEN_FUNCPTR *)(GLuint, GLuint, GLuint, GLintptr, GLsizei))IntGetProcAddress("glVertexArrayVertexBuffer");
+	if(!_ptrc_glVertexArrayVertexBuffer) numFailed++;
+	return numFailed;
+}
+
+void (CODEGEN_FUNCPTR *_ptrc_glMultiDrawArraysIndirectCountARB)(GLenum, GLintptr, GLintptr, GLsizei, GLsizei) = NULL;
+void (CODEGEN_FUNCPTR *_ptrc_glMultiDrawElementsIndirectCountARB)(GLenum, GLenum, GLintptr, GLintptr, GLsizei, GLsizei) = NULL;
+
+static int Load_ARB_indirect_parameters()
+{
+	int numFailed = 0;
+	_ptrc_glMultiDrawArraysIndirectCountARB = (void (CODEGEN_FUNCPTR *)(GLenum, GLintptr, GLintptr, GLsizei, GLsizei))IntGetProcAddress("glMultiDrawArraysIndirectCountARB");
+	if(!_ptrc_glMultiDrawArraysIndirectCountARB) numFailed++;
+	_ptrc_glMultiDrawElementsIndirectCountARB = (void (CODEGEN_FUNCPTR *)(GLenum, GLenum, GLintptr, GLintptr, GLsizei, GLsizei))IntGetProcAddress("glMultiDrawElementsIndirectCountARB");
+	if(!_ptrc_glMultiDrawElementsIndirectCountARB) numFailed++;
+	return numFailed;
+}
+
 void (CODEGEN_FUNCPTR *_ptrc_glBlendFunc)(GLenum, GLenum) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glClear)(GLbitfield) = NULL;
 void (CODEGEN_FUNCPTR *_ptrc_glClearColor)(GLfloat, GLfloat, GLfloat, GLfloat) = NULL;
@@ -1863,11 +1938,15 @@ typedef struct ogl_StrToExtMap_s
 	PFN_LOADFUNCPOINTERS LoadExtension;
 } ogl_StrToExtMap;
 
-static ogl_StrToExtMap ExtensionMap[1] = {
+static ogl_StrToExtMap ExtensionMap[5] = {
 	{"GL_ARB_debug_output", &ogl_ext_ARB_debug_output, Load_ARB_debug_output},
+	{"GL_ARB_direct_state_access", &ogl_ext_ARB_direct_state_access, Load_ARB_direct_state_access},
+	{"GL_ARB_indirect_parameters", &ogl_ext_ARB_indirect_parameters, Load_ARB_indirect_parameters},
+	{"GL_ARB_pipeline_statistics_query", &ogl_ext_ARB_pipeline_statistics_query, NULL},
+	{"GL_ARB_shader_draw_parameters", &ogl_ext_ARB_shader_draw_parameters, NULL},
 };
 
-static int g_extensionMapSize = 1;
+static int g_extensionMapSize = 5;
 
 static ogl_StrToExtMap *FindExtEntry(const char *extensionName)
 {
@@ -1885,6 +1964,10 @@ static ogl_StrToExtMap *FindExtEntry(const char *extensionName)
 static void ClearExtensionVars()
 {
 	ogl_ext_ARB_debug_output = ogl_LOAD_FAILED;
+	ogl_ext_ARB_direct_state_access = ogl_LOAD_FAILED;
+	ogl_ext_ARB_indirect_parameters = ogl_LOAD_FAILED;
+	ogl_ext_ARB_pipeline_statistics_query = ogl_LOAD_FAILED;
+	ogl_ext_ARB_shader_draw_parameters = ogl_LOAD_FAILED;
 }
 
 
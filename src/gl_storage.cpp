@@ -0,0 +1,419 @@
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include "gl_core_4_4.h"
+#include "gl_caps.h"
+#include "gpu_memory.h"
+#include "gl_storage.h"
+
+GLStorage::GLStorage(size_t bytes, GLenum type, GLenum access, bool allow_name_change)
+	: bytes(bytes), buffer(0), type(type), access(access), bound_target(type),
+	allow_name_change(allow_name_change), arena(nullptr), strategy(UploadStrategy::DEFAULT),
+	dsa(util::has_dsa()), immutable(dsa && allow_name_change), staging(nullptr),
+	staged_offset(0), staged_length(0), category(gpu_memory::category_for_target(type))
+{
+	buffer = create_buffer();
+	if (bytes > 0){
+		alloc_storage(buffer, bytes);
+		gpu_memory::track_alloc(category, bytes);
+	}
+}
+GLStorage::GLStorage(BufferArena &arena, size_t bytes, GLenum type)
+	: bytes(bytes), buffer(0), type(type), access(0), bound_target(type),
+	allow_name_change(true), arena(&arena), strategy(UploadStrategy::DEFAULT),
+	dsa(util::has_dsa()), immutable(false), staging(nullptr), staged_offset(0), staged_length(0),
+	category(gpu_memory::category_for_target(type))
+{
+	if (bytes > 0){
+		range = arena.alloc(bytes);
+		buffer = range.buffer;
+	}
+}
+GLStorage::~GLStorage(){
+	release();
+}
+GLStorage::GLStorage(GLStorage &&s)
+	: bytes(s.bytes), buffer(s.buffer), type(s.type), access(s.access),
+	bound_target(s.bound_target), allow_name_change(s.allow_name_change), arena(s.arena),
+	range(s.range), strategy(s.strategy), fences(std::move(s.fences)), stats(s.stats),
+	dsa(s.dsa), immutable(s.immutable), staging(s.staging), staged(s.staged),
+	staged_offset(s.staged_offset), staged_length(s.staged_length), category(s.category)
+{
+	s.drop_buffer();
+}
+GLStorage& GLStorage::operator=(GLStorage &&s){
+	if (this == &s){
+		return *this;
+	}
+	release();
+	bytes = s.bytes;
+	buffer = s.buffer;
+	type = s.type;
+	access = s.access;
+	bound_target = s.bound_target;
+	allow_name_change = s.allow_name_change;
+	arena = s.arena;
+	range = s.range;
+	strategy = s.strategy;
+	fences = std::move(s.fences);
+	stats = s.stats;
+	dsa = s.dsa;
+	immutable = s.immutable;
+	staging = s.staging;
+	staged = s.staged;
+	staged_offset = s.staged_offset;
+	staged_length = s.staged_length;
+	category = s.category;
+	s.drop_buffer();
+	return *this;
+}
+GLuint GLStorage::buf() const {
+	return buffer;
+}
+size_t GLStorage::base_offset() const {
+	return range.offset;
+}
+size_t GLStorage::size() const {
+	return bytes;
+}
+void GLStorage::bind(){
+	assert(buffer != 0);
+	bound_target = type;
+	glBindBuffer(bound_target, buffer);
+}
+void GLStorage::bind(GLenum target){
+	assert(buffer != 0);
+	bound_target = target;
+	glBindBuffer(bound_target, buffer);
+}
+void GLStorage::unbind(){
+	glBindBuffer(bound_target, 0);
+}
+void GLStorage::bind_base(int index){
+	assert(buffer != 0);
+	bound_target = type;
+	if (arena){
+		glBindBufferRange(bound_target, index, buffer, range.offset, bytes);
+	}
+	else {
+		glBindBufferBase(bound_target, index, buffer);
+	}
+}
+void GLStorage::bind_base(GLenum target, int index){
+	assert(buffer != 0);
+	bound_target = target;
+	if (arena){
+		glBindBufferRange(bound_target, index, buffer, range.offset, bytes);
+	}
+	else {
+		glBindBufferBase(bound_target, index, buffer);
+	}
+}
+void GLStorage::bind_range(int index, size_t offset, size_t length){
+	assert(buffer != 0 && offset + length <= bytes);
+	bound_target = type;
+	glBindBufferRange(bound_target, index, buffer, range.offset + offset, length);
+}
+char* GLStorage::map(size_t offset, size_t length, GLbitfield flags, const char *refill){
+	assert(offset + length <= bytes);
+	if (!dsa){
+		bind();
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	if ((flags & GL_MAP_WRITE_BIT) && !(flags & GL_MAP_READ_BIT)){
+		switch (strategy){
+			case UploadStrategy::ORPHAN:
+				if (!orphan(offset, length, refill)){
+					flags |= GL_MAP_INVALIDATE_RANGE_BIT;
+				}
+				break;
+			case UploadStrategy::INVALIDATE:
+				flags |= GL_MAP_INVALIDATE_RANGE_BIT;
+				break;
+			case UploadStrategy::UNSYNCHRONIZED:
+				wait_fences(offset, offset + length);
+				flags |= GL_MAP_UNSYNCHRONIZED_BIT;
+				break;
+			default:
+				break;
+		}
+	}
+	char *ptr = nullptr;
+	if (dsa){
+		ptr = static_cast<char*>(glMapNamedBufferRange(buffer, range.offset + offset, length, flags));
+	}
+	else {
+		//Orphaning may have rebound the buffer to upload the refill
+		bind();
+		ptr = static_cast<char*>(glMapBufferRange(bound_target, range.offset + offset, length, flags));
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+	MapStats &st = stats[static_cast<size_t>(strategy)];
+	++st.maps;
+	st.total_ms += ms;
+	st.max_ms = std::max(st.max_ms, ms);
+	return ptr;
+}
+char* GLStorage::map_staged(StagingPool &pool, size_t offset, size_t length){
+	assert(offset + length <= bytes);
+	staging = &pool;
+	staged = pool.acquire(length);
+	staged_offset = offset;
+	staged_length = length;
+	return staged.ptr;
+}
+void GLStorage::flush(size_t offset, size_t length){
+	if (dsa){
+		glFlushMappedNamedBufferRange(buffer, offset, length);
+	}
+	else {
+		glFlushMappedBufferRange(bound_target, offset, length);
+	}
+}
+void GLStorage::unmap(){
+	//Staged writes are copied over instead of unmapping the buffer
+	if (staging){
+		staging->submit(staged, buffer, range.offset + staged_offset, staged_length);
+		staging = nullptr;
+		staged = StagingBlock{};
+	}
+	else {
+		unmap_buffer();
+	}
+}
+void GLStorage::upload(size_t offset, size_t length, const void *src){
+	assert(offset + length <= bytes);
+	if (dsa){
+		glNamedBufferSubData(buffer, range.offset + offset, length, src);
+	}
+	else {
+		glBindBuffer(type, buffer);
+		glBufferSubData(type, range.offset + offset, length, src);
+	}
+}
+void GLStorage::download(size_t offset, size_t length, void *dst){
+	assert(offset + length <= bytes);
+	if (dsa){
+		glGetNamedBufferSubData(buffer, range.offset + offset, length, dst);
+	}
+	else {
+		glBindBuffer(type, buffer);
+		glGetBufferSubData(type, range.offset + offset, length, dst);
+	}
+}
+void GLStorage::copy(size_t src_offset, size_t dst_offset, size_t length){
+	assert(src_offset + length <= bytes && dst_offset + length <= bytes);
+	copy_buffer(buffer, range.offset + src_offset, buffer, range.offset + dst_offset, length);
+}
+void GLStorage::reserve(size_t new_bytes){
+	if (new_bytes < bytes){
+		return;
+	}
+	//Our old storage is going away so fences on it no longer matter
+	clear_fences();
+	if (bytes > 0){
+		gpu_memory::track_reserve_copy(category, bytes);
+	}
+	//With an arena we move to a new range and copy the old data over
+	if (arena){
+		ArenaRange old = range;
+		range = arena->alloc(new_bytes);
+		if (bytes > 0){
+			copy_buffer(old.buffer, old.offset, range.buffer, range.offset, bytes);
+			arena->release(old);
+		}
+		buffer = range.buffer;
+	}
+	//If there's no old data we need to preserve we can just allocate
+	//the new size
+	else if (bytes == 0){
+		alloc_storage(buffer, new_bytes);
+		gpu_memory::track_alloc(category, new_bytes);
+	}
+	else {
+		GLuint tmp = create_buffer();
+		//If we're allowed to change the buffer name then we're moving over
+		//to this new name and should allocate enough room for the new size
+		if (allow_name_change){
+			alloc_storage(tmp, new_bytes);
+			gpu_memory::track_alloc(category, new_bytes);
+		}
+		//If we can't change names then just make enough room to save the old data
+		//while we re-alloc the old name
+		else {
+			alloc_storage(tmp, bytes);
+			gpu_memory::track_alloc(category, bytes);
+		}
+		copy_buffer(buffer, 0, tmp, 0, bytes);
+		if (allow_name_change){
+			glDeleteBuffers(1, &buffer);
+			gpu_memory::track_free(category, bytes);
+			buffer = tmp;
+		}
+		//If we can't change names now we need to resize the old buffer and move the old data back
+		else {
+			alloc_storage(buffer, new_bytes);
+			gpu_memory::track_free(category, bytes);
+			gpu_memory::track_alloc(category, new_bytes);
+			copy_buffer(tmp, 0, buffer, 0, bytes);
+			glDeleteBuffers(1, &tmp);
+			gpu_memory::track_free(category, bytes);
+		}
+	}
+	bytes = new_bytes;
+}
+void GLStorage::set_upload_strategy(UploadStrategy s){
+	strategy = s;
+}
+UploadStrategy GLStorage::upload_strategy() const {
+	return strategy;
+}
+void GLStorage::fence(size_t offset, size_t length){
+	assert(offset + length <= bytes);
+	if (strategy != UploadStrategy::UNSYNCHRONIZED || length == 0){
+		return;
+	}
+	//Drop any fences the GPU has already passed
+	fences.erase(std::remove_if(fences.begin(), fences.end(),
+		[](const RangeFence &f){
+			GLenum status = glClientWaitSync(f.sync, 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED){
+				glDeleteSync(f.sync);
+				return true;
+			}
+			return false;
+		}),
+		fences.end());
+	fences.emplace_back(offset, offset + length, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+const MapStats& GLStorage::map_stats(UploadStrategy s) const {
+	return stats[static_cast<size_t>(s)];
+}
+void GLStorage::reset_map_stats(){
+	stats.fill(MapStats{});
+}
+void GLStorage::set_mem_category(MemCategory c){
+	if (!arena && bytes > 0){
+		gpu_memory::retag(category, c, bytes);
+	}
+	category = c;
+}
+MemCategory GLStorage::mem_category() const {
+	return category;
+}
+bool GLStorage::orphan(size_t offset, size_t length, const char *refill){
+	if (arena || (!refill && length != bytes)){
+		return false;
+	}
+	//Immutable storage can't be re-specified but invalidating it gives the driver
+	//the same chance to hand us fresh memory
+	if (immutable){
+		glInvalidateBufferData(buffer);
+	}
+	else {
+		alloc_storage(buffer, bytes);
+	}
+	if (offset > 0){
+		upload(0, offset, refill);
+	}
+	if (offset + length < bytes){
+		upload(offset + length, bytes - offset - length, refill + offset + length);
+	}
+	return true;
+}
+GLuint GLStorage::create_buffer(){
+	GLuint b = 0;
+	if (dsa){
+		glCreateBuffers(1, &b);
+	}
+	else {
+		glGenBuffers(1, &b);
+	}
+	return b;
+}
+void GLStorage::alloc_storage(GLuint b, size_t size){
+	if (immutable){
+		glNamedBufferStorage(b, size, NULL, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+	}
+	else if (dsa){
+		glNamedBufferData(b, size, NULL, access);
+	}
+	else {
+		glBindBuffer(type, b);
+		glBufferData(type, size, NULL, access);
+	}
+}
+void GLStorage::copy_buffer(GLuint src, size_t src_offset, GLuint dst, size_t dst_offset, size_t length){
+	if (dsa){
+		glCopyNamedBufferSubData(src, dst, src_offset, dst_offset, length);
+	}
+	else {
+		glBindBuffer(GL_COPY_READ_BUFFER, src);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, src_offset, dst_offset, length);
+	}
+}
+void GLStorage::unmap_buffer(){
+	if (dsa){
+		glUnmapNamedBuffer(buffer);
+	}
+	else {
+		glBindBuffer(bound_target, buffer);
+		glUnmapBuffer(bound_target);
+	}
+}
+void GLStorage::wait_fences(size_t start, size_t end){
+	fences.erase(std::remove_if(fences.begin(), fences.end(),
+		[start, end](const RangeFence &f){
+			if (f.end <= start || f.start >= end){
+				return false;
+			}
+			GLenum status = glClientWaitSync(f.sync, 0, 0);
+			while (status == GL_TIMEOUT_EXPIRED){
+				status = glClientWaitSync(f.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			}
+			glDeleteSync(f.sync);
+			return true;
+		}),
+		fences.end());
+}
+void GLStorage::clear_fences(){
+	for (auto &f : fences){
+		glDeleteSync(f.sync);
+	}
+	fences.clear();
+}
+void GLStorage::release(){
+	if (buffer != 0){
+		clear_fences();
+		if (arena){
+			arena->release(range);
+		}
+		else {
+			glDeleteBuffers(1, &buffer);
+			if (bytes > 0){
+				gpu_memory::track_free(category, bytes);
+			}
+		}
+	}
+}
+void GLStorage::drop_buffer(){
+	bytes = 0;
+	buffer = 0;
+	type = 0;
+	access = 0;
+	bound_target = 0;
+	arena = nullptr;
+	range = ArenaRange{};
+	strategy = UploadStrategy::DEFAULT;
+	fences.clear();
+	reset_map_stats();
+	dsa = false;
+	immutable = false;
+	staging = nullptr;
+	staged = StagingBlock{};
+	staged_offset = 0;
+	staged_length = 0;
+	category = MemCategory::OTHER;
+}
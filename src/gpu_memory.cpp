@@ -0,0 +1,137 @@
+#include <cassert>
+#include <array>
+#include <unordered_map>
+#include <iomanip>
+#include <algorithm>
+#include "gl_core_4_4.h"
+#include "gpu_memory.h"
+
+namespace {
+	std::array<MemStats, NUM_MEM_CATEGORIES> categories;
+	std::unordered_map<GLuint, size_t> textures;
+	size_t total_current = 0, total_peak = 0;
+
+	MemStats& get(MemCategory c){
+		return categories[static_cast<size_t>(c)];
+	}
+}
+
+void gpu_memory::track_alloc(MemCategory c, size_t bytes){
+	MemStats &s = get(c);
+	s.current += bytes;
+	s.peak = std::max(s.peak, s.current);
+	++s.allocs;
+	total_current += bytes;
+	total_peak = std::max(total_peak, total_current);
+}
+void gpu_memory::track_free(MemCategory c, size_t bytes){
+	MemStats &s = get(c);
+	assert(s.current >= bytes);
+	s.current -= bytes;
+	++s.frees;
+	total_current -= bytes;
+}
+void gpu_memory::retag(MemCategory from, MemCategory to, size_t bytes){
+	if (from == to){
+		return;
+	}
+	MemStats &f = get(from);
+	MemStats &t = get(to);
+	assert(f.current >= bytes);
+	f.current -= bytes;
+	t.current += bytes;
+	t.peak = std::max(t.peak, t.current);
+}
+void gpu_memory::track_reserve_copy(MemCategory c, size_t bytes){
+	MemStats &s = get(c);
+	++s.reserve_copies;
+	s.reserve_bytes += bytes;
+}
+void gpu_memory::track_texture(GLuint tex, size_t bytes){
+	textures[tex] = bytes;
+	track_alloc(MemCategory::TEXTURE, bytes);
+}
+void gpu_memory::release_texture(GLuint tex){
+	auto it = textures.find(tex);
+	if (it != textures.end()){
+		track_free(MemCategory::TEXTURE, it->second);
+		textures.erase(it);
+	}
+}
+const MemStats& gpu_memory::stats(MemCategory c){
+	return get(c);
+}
+size_t gpu_memory::current_bytes(){
+	return total_current;
+}
+size_t gpu_memory::peak_bytes(){
+	return total_peak;
+}
+void gpu_memory::reset_peaks(){
+	for (auto &s : categories){
+		s.peak = s.current;
+	}
+	total_peak = total_current;
+}
+MemCategory gpu_memory::category_for_target(GLenum target){
+	switch (target){
+		case GL_ARRAY_BUFFER:
+			return MemCategory::VERTEX;
+		case GL_ELEMENT_ARRAY_BUFFER:
+			return MemCategory::INDEX;
+		case GL_DRAW_INDIRECT_BUFFER:
+		case GL_DISPATCH_INDIRECT_BUFFER:
+			return MemCategory::INDIRECT;
+		case GL_UNIFORM_BUFFER:
+			return MemCategory::UNIFORM;
+		case GL_SHADER_STORAGE_BUFFER:
+			return MemCategory::STORAGE;
+		case GL_COPY_READ_BUFFER:
+		case GL_PIXEL_UNPACK_BUFFER:
+			return MemCategory::STAGING;
+		default:
+			return MemCategory::OTHER;
+	}
+}
+const char* gpu_memory::category_name(MemCategory c){
+	switch (c){
+		case MemCategory::VERTEX:
+			return "vertex";
+		case MemCategory::INDEX:
+			return "index";
+		case MemCategory::INSTANCE:
+			return "instance";
+		case MemCategory::INDIRECT:
+			return "indirect";
+		case MemCategory::UNIFORM:
+			return "uniform";
+		case MemCategory::STORAGE:
+			return "storage";
+		case MemCategory::STAGING:
+			return "staging";
+		case MemCategory::ARENA:
+			return "arena";
+		case MemCategory::TEXTURE:
+			return "texture";
+		default:
+			return "other";
+	}
+}
+void gpu_memory::print(std::ostream &os){
+	const double kb = 1024.0;
+	os << std::left << std::setw(10) << "category" << std::right << std::setw(12) << "current KB"
+		<< std::setw(12) << "peak KB" << std::setw(8) << "allocs" << std::setw(8) << "frees"
+		<< std::setw(10) << "reserves" << std::setw(14) << "reserve KB" << "\n";
+	for (size_t i = 0; i < NUM_MEM_CATEGORIES; ++i){
+		const MemStats &s = categories[i];
+		if (s.allocs == 0 && s.current == 0 && s.reserve_copies == 0){
+			continue;
+		}
+		os << std::left << std::setw(10) << category_name(static_cast<MemCategory>(i)) << std::right
+			<< std::fixed << std::setprecision(1) << std::setw(12) << s.current / kb << std::setw(12) << s.peak / kb
+			<< std::setw(8) << s.allocs << std::setw(8) << s.frees << std::setw(10) << s.reserve_copies
+			<< std::setw(14) << s.reserve_bytes / kb << "\n";
+	}
+	os << std::left << std::setw(10) << "total" << std::right << std::setw(12) << total_current / kb
+		<< std::setw(12) << total_peak / kb << std::endl;
+}
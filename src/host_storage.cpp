@@ -0,0 +1,122 @@
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include "host_storage.h"
+
+HostStorage::HostStorage(size_t bytes, GLenum, GLenum, bool)
+	: bytes(bytes), data(nullptr), strategy(UploadStrategy::DEFAULT),
+	category(MemCategory::OTHER)
+{
+	memory = alloc(bytes, data);
+}
+HostStorage::HostStorage(BufferArena&, size_t bytes, GLenum)
+	: bytes(bytes), data(nullptr), strategy(UploadStrategy::DEFAULT),
+	category(MemCategory::OTHER)
+{
+	memory = alloc(bytes, data);
+}
+HostStorage::HostStorage(HostStorage &&s)
+	: bytes(s.bytes), memory(std::move(s.memory)), data(s.data), strategy(s.strategy), stats(s.stats),
+	category(s.category)
+{
+	s.bytes = 0;
+	s.data = nullptr;
+	s.reset_map_stats();
+}
+HostStorage& HostStorage::operator=(HostStorage &&s){
+	if (this == &s){
+		return *this;
+	}
+	bytes = s.bytes;
+	memory = std::move(s.memory);
+	data = s.data;
+	strategy = s.strategy;
+	stats = s.stats;
+	category = s.category;
+	s.bytes = 0;
+	s.data = nullptr;
+	s.reset_map_stats();
+	return *this;
+}
+GLuint HostStorage::buf() const {
+	return 0;
+}
+size_t HostStorage::base_offset() const {
+	return 0;
+}
+size_t HostStorage::size() const {
+	return bytes;
+}
+void HostStorage::bind(){}
+void HostStorage::bind(GLenum){}
+void HostStorage::unbind(){}
+void HostStorage::bind_base(int){}
+void HostStorage::bind_base(GLenum, int){}
+void HostStorage::bind_range(int, size_t, size_t){}
+char* HostStorage::map(size_t offset, size_t length, GLbitfield, const char*){
+	assert(offset + length <= bytes);
+	(void)length;
+	++stats[static_cast<size_t>(strategy)].maps;
+	return data + offset;
+}
+char* HostStorage::map_staged(StagingPool&, size_t offset, size_t length){
+	return map(offset, length, GL_MAP_WRITE_BIT, nullptr);
+}
+void HostStorage::flush(size_t, size_t){}
+void HostStorage::unmap(){}
+void HostStorage::upload(size_t offset, size_t length, const void *src){
+	assert(offset + length <= bytes);
+	std::memcpy(data + offset, src, length);
+}
+void HostStorage::download(size_t offset, size_t length, void *dst){
+	assert(offset + length <= bytes);
+	std::memcpy(dst, data + offset, length);
+}
+void HostStorage::copy(size_t src_offset, size_t dst_offset, size_t length){
+	assert(src_offset + length <= bytes && dst_offset + length <= bytes);
+	std::memmove(data + dst_offset, data + src_offset, length);
+}
+void HostStorage::reserve(size_t new_bytes){
+	if (new_bytes < bytes){
+		return;
+	}
+	char *new_data = nullptr;
+	auto new_memory = alloc(new_bytes, new_data);
+	if (bytes > 0){
+		std::memcpy(new_data, data, bytes);
+	}
+	memory = std::move(new_memory);
+	data = new_data;
+	bytes = new_bytes;
+}
+void HostStorage::set_upload_strategy(UploadStrategy s){
+	strategy = s;
+}
+UploadStrategy HostStorage::upload_strategy() const {
+	return strategy;
+}
+void HostStorage::fence(size_t, size_t){}
+const MapStats& HostStorage::map_stats(UploadStrategy s) const {
+	return stats[static_cast<size_t>(s)];
+}
+void HostStorage::reset_map_stats(){
+	stats.fill(MapStats{});
+}
+void HostStorage::set_mem_category(MemCategory c){
+	category = c;
+}
+MemCategory HostStorage::mem_category() const {
+	return category;
+}
+std::unique_ptr<char[]> HostStorage::alloc(size_t size, char *&ptr){
+	if (size == 0){
+		ptr = nullptr;
+		return nullptr;
+	}
+	//Over-allocate so we can step forward to the next aligned address
+	std::unique_ptr<char[]> mem{new char[size + ALIGNMENT - 1]()};
+	const uintptr_t addr = reinterpret_cast<uintptr_t>(mem.get());
+	ptr = mem.get() + (ALIGNMENT - addr % ALIGNMENT) % ALIGNMENT;
+	return mem;
+}
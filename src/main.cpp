@@ -5,6 +5,15 @@
 #include <glm/ext.hpp>
 #include "gl_core_4_4.h"
 #include "util.h"
+#include "buffer_arena.h"
+#include "staging_pool.h"
+#include "gpu_memory.h"
+#include "gl_caps.h"
+#include "frustum.h"
+#include "thread_pool.h"
+#include "depth_pyramid.h"
+#include "occlusion_buffer.h"
+#include "render_queue.h"
 #include "multi_renderbatch.h"
 
 int main(int, char**){
@@ -56,51 +65,133 @@ int main(int, char**){
 	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
 #endif
 
+	//Keep the view and projection around to cull against
+	glm::mat4 view = glm::lookAt(glm::vec3{0.f, 4.f, 8.f}, glm::vec3{0.f, 0.f, 0.f}, glm::vec3{0.f, 1.f, 0.f});
+	const glm::mat4 proj = glm::perspective(util::deg_to_rad(75.f), 640.f / 480.f, 1.f, 100.f);
 	STD140Buffer<glm::mat4> viewing{2, GL_UNIFORM_BUFFER, GL_STATIC_DRAW};
 	viewing.map(GL_WRITE_ONLY);
-	viewing.write<0>(0) = glm::lookAt(glm::vec3{0.f, 4.f, 8.f}, glm::vec3{0.f, 0.f, 0.f},
-		glm::vec3{0.f, 1.f, 0.f});
-	viewing.write<0>(1) = glm::perspective(util::deg_to_rad(75.f), 640.f / 480.f, 1.f, 100.f);
+	viewing.write<0>(0) = view;
+	viewing.write<0>(1) = proj;
 	viewing.unmap();
 
 	const std::string shader_path = util::get_resource_path("shaders");
+	//The instance transforms are GridTransforms, which the shaders decode with grid_transform.glsl
+	const std::vector<std::string> grid_transform_src{shader_path + "grid_transform.glsl"};
 	GLuint shader = util::load_program({std::make_tuple(GL_VERTEX_SHADER, shader_path + "vmdei_test.glsl"),
-		std::make_tuple(GL_FRAGMENT_SHADER, shader_path + "fmdei_test.glsl")});
+		std::make_tuple(GL_FRAGMENT_SHADER, shader_path + "fmdei_test.glsl")}, grid_transform_src);
 	glUseProgram(shader);
 	GLuint viewing_block = glGetUniformBlockIndex(shader, "Viewing");
 	glUniformBlockBinding(shader, viewing_block, 0);
 	viewing.bind_base(0);
+	//With ARB_shader_draw_parameters the instances can also be read from a storage buffer
+	//by a second program, which shares the viewing block binding
+	GLuint storage_shader = 0;
+	if (util::has_shader_draw_parameters()){
+		storage_shader = util::load_program({std::make_tuple(GL_VERTEX_SHADER, shader_path + "vmdei_storage.glsl"),
+			std::make_tuple(GL_FRAGMENT_SHADER, shader_path + "fmdei_test.glsl")}, grid_transform_src);
+		glUniformBlockBinding(storage_shader, glGetUniformBlockIndex(storage_shader, "Viewing"), 0);
+	}
+	GLuint cull_shader = util::load_program({std::make_tuple(GL_COMPUTE_SHADER, shader_path + "cull_instances.glsl")},
+		grid_transform_src);
+	GLuint compact_shader = util::load_program({std::make_tuple(GL_COMPUTE_SHADER, shader_path + "compact_commands.glsl")});
+	GLuint pyramid_shader = util::load_program({std::make_tuple(GL_COMPUTE_SHADER, shader_path + "depth_pyramid.glsl")});
 
+	//The tile models, instance attributes and draw commands all share the arena's buffers
+	BufferArena arena{1 << 20};
+	StagingPool staging;
 	const std::string model_path = util::get_resource_path("models");
-	PackedBuffer<glm::vec3, glm::vec3, glm::vec3> vbo{0, GL_ARRAY_BUFFER, GL_STATIC_DRAW, true};
-	PackedBuffer<GLushort> ebo{0, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW, true};
+	PackedBuffer<glm::vec3, glm::vec3, glm::vec3> vbo{arena, 0, GL_ARRAY_BUFFER};
+	PackedBuffer<GLushort> ebo{arena, 0, GL_ELEMENT_ARRAY_BUFFER};
 	std::vector<size_t> num_verts(3), num_elems(3);
-	if (!util::load_obj(model_path + "dented_tile.obj", vbo, ebo, num_elems[0], &num_verts[0])){
+	std::vector<AABB> bounds(3);
+	if (!util::load_obj(model_path + "dented_tile.obj", vbo, ebo, num_elems[0], &num_verts[0], 0, 0, &staging,
+		&bounds[0]))
+	{
 		std::cout << "Failed to load dented tile\n";
 		return 1;
 	}
-	if (!util::load_obj(model_path + "spike_tile.obj", vbo, ebo, num_elems[1], &num_verts[1], num_verts[0], num_elems[0])){
+	if (!util::load_obj(model_path + "spike_tile.obj", vbo, ebo, num_elems[1], &num_verts[1], num_verts[0], num_elems[0],
+		&staging, &bounds[1]))
+	{
 		std::cout << "Failed to load spike tile\n";
 		return 1;
 	}
 	if (!util::load_obj(model_path + "big_tile.obj", vbo, ebo, num_elems[2], &num_verts[2],
-		num_verts[0] + num_verts[1], num_elems[0] + num_elems[1]))
+		num_verts[0] + num_verts[1], num_elems[0] + num_elems[1], &staging, &bounds[2]))
 	{
 		std::cout << "Failed to load big tile\n";
 		return 1;
 	}
 
-	MultiRenderBatch<glm::vec3, glm::mat4> tile_batches{{4, 4, 2}, num_elems, {0, num_elems[0], num_elems[0] + num_elems[1]},
-		std::move(vbo), std::move(ebo)};
-	tile_batches.set_attrib_indices({2, 3});
-	tile_batches.push_instance(0, std::make_tuple(glm::vec3{1.f, 0.f, 0.f}, glm::translate(glm::vec3{-3.f, 0.f, 1.f})));
-	tile_batches.push_instance(0, std::make_tuple(glm::vec3{1.f, 0.f, 1.f}, glm::translate(glm::vec3{1.f, 0.f, -3.f})));
-	tile_batches.push_instance(0, std::make_tuple(glm::vec3{1.f, 0.f, 1.f}, glm::translate(glm::vec3{1.f, 0.f, 3.f})
-		* glm::rotate(util::deg_to_rad(90), glm::vec3{0, 1, 0})));
-	tile_batches.push_instance(1, std::make_tuple(glm::vec3{0.f, 0.f, 1.f}, glm::translate(glm::vec3{3.f, 0.f, 1.f})));
-	tile_batches.push_instance(1, std::make_tuple(glm::vec3{1.f, 1.f, 0.f}, glm::translate(glm::vec3{-1.f, 0.f, -3.f})));
-	tile_batches.push_instance(1, std::make_tuple(glm::vec3{0.f, 0.f, 1.f}, glm::translate(glm::vec3{-3.f, 0.f, -1.f})));
-	tile_batches.push_instance(2, std::make_tuple(glm::vec3{1.f, 0.5f, 0.5f}, glm::translate(glm::vec3{0.f, 0.f, 0.f})));
+	//The tiles' materials are layers of one texture array so every tile is still drawn in one call,
+	//each instance picks its layer with its last attribute
+	glActiveTexture(GL_TEXTURE1);
+	const std::string texture_path = util::get_resource_path("textures");
+	GLuint tile_textures = util::load_texture_array({texture_path + "stone.png", texture_path + "brick.png",
+		texture_path + "wood.png", texture_path + "grass.png"});
+	glActiveTexture(GL_TEXTURE0);
+	if (tile_textures == 0){
+		std::cout << "Failed to load tile textures\n";
+		return 1;
+	}
+	enum TileMaterial : uint32_t { STONE, BRICK, WOOD, GRASS };
+
+	//The tiles sit on the integer grid so are placed by compact grid transforms instead of a mat4
+	MultiRenderBatch<UNorm8x4, GridTransform, uint32_t> tile_batches{{4, 4, 2}, num_elems, {0, num_elems[0], num_elems[0] + num_elems[1]},
+		std::move(vbo), std::move(ebo), &arena};
+	tile_batches.set_attrib_indices({3, 4, 5});
+	tile_batches.enable_gpu_culling<1>(cull_shader, bounds, compact_shader);
+	ThreadPool cull_pool;
+	tile_batches.push_instances({
+		{0, std::make_tuple(UNorm8x4{glm::vec3{1.f, 0.f, 0.f}}, GridTransform{glm::ivec3{-3, 0, 1}}, STONE)},
+		{0, std::make_tuple(UNorm8x4{glm::vec3{1.f, 0.f, 1.f}}, GridTransform{glm::ivec3{1, 0, -3}}, BRICK)},
+		{0, std::make_tuple(UNorm8x4{glm::vec3{1.f, 0.f, 1.f}}, GridTransform{glm::translate(glm::vec3{1.f, 0.f, 3.f})
+			* glm::rotate(util::deg_to_rad(90), glm::vec3{0, 1, 0})}, WOOD)},
+		{1, std::make_tuple(UNorm8x4{glm::vec3{0.f, 0.f, 1.f}}, GridTransform{glm::ivec3{3, 0, 1}}, GRASS)},
+		{1, std::make_tuple(UNorm8x4{glm::vec3{1.f, 1.f, 0.f}}, GridTransform{glm::ivec3{-1, 0, -3}}, STONE)},
+		{1, std::make_tuple(UNorm8x4{glm::vec3{0.f, 0.f, 1.f}}, GridTransform{glm::ivec3{-3, 0, -1}}, WOOD)},
+		{2, std::make_tuple(UNorm8x4{glm::vec3{1.f, 0.5f, 0.5f}}, GridTransform{glm::ivec3{0, 0, 0}}, BRICK)}
+	});
+
+	//The big tiles are the only model large enough to hide much, so only they're drawn as occluders
+	const size_t big_tile_model = 2;
+	//The big tiles drawn each frame are drawn again into the depth pyramid as next frame's occluders
+	DepthPyramid pyramid{640, 480, pyramid_shader};
+	//For CPU culling the big tiles are drawn into a software occlusion buffer with a box
+	//proxy of their base, which sits inside the bumps on top
+	OcclusionBuffer software_occlusion{256, 192};
+	const OccluderMesh big_tile_proxy = OccluderMesh::box(AABB{glm::vec3{-2.f, -1.f, -2.f}, glm::vec3{2.f, 0.5f, 2.f}});
+	bool occlusion = false;
+	//A new count is only started once the last one's result is in, so reading it never waits on the GPU
+	auto read_query = [](GLuint query, GLuint64 &result){
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available){
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+		}
+		return available != 0;
+	};
+	GLuint prims_query;
+	glGenQueries(1, &prims_query);
+	GLuint64 prims_drawn = 0;
+	bool prims_pending = false;
+	//The triangles drawn into the depth pyramid are counted separately
+	GLuint occluder_query;
+	glGenQueries(1, &occluder_query);
+	GLuint64 occluder_prims_drawn = 0;
+	bool occluder_pending = false;
+	//Count the fragments shaded to see how much overdraw sorting front to back saves
+	const bool pipeline_stats = util::has_pipeline_statistics();
+	GLuint frags_query = 0;
+	if (pipeline_stats){
+		glGenQueries(1, &frags_query);
+	}
+	GLuint64 frags_shaded = 0;
+	bool frags_pending = false;
+	bool depth_sort = false;
+	//Draws for the frame go through the queue to be sorted by the state they need
+	RenderQueue render_queue;
+	const TextureBinding tile_texture_binding{1, GL_TEXTURE_2D_ARRAY, tile_textures};
 
 	SDL_Event e;
 	bool quit = false, view_change = false;
@@ -120,6 +211,108 @@ int main(int, char**){
 						view_pos = view_pos == 0 ? 3 : (view_pos - 1) % 4;
 						view_change = true;
 						break;
+					case SDLK_m:
+						gpu_memory::print(std::cout);
+						break;
+					//Cycle through GPU, CPU and no culling
+					case SDLK_c:
+						switch (tile_batches.cull_mode()){
+							case CullMode::GPU:
+								tile_batches.enable_cpu_culling<1>(cull_pool, bounds);
+								std::cout << "CPU culling\n";
+								break;
+							case CullMode::CPU:
+								tile_batches.disable_culling();
+								std::cout << "No culling\n";
+								break;
+							default:
+								//The pyramid wasn't drawn while CPU culling so its occluders are out of date
+								pyramid.clear();
+								tile_batches.enable_gpu_culling<1>(cull_shader, bounds, compact_shader);
+								std::cout << "GPU culling\n";
+								break;
+						}
+						break;
+					case SDLK_o:
+						occlusion = !occlusion;
+						tile_batches.set_occlusion(occlusion ? &pyramid : nullptr);
+						tile_batches.set_software_occlusion(occlusion ? &software_occlusion : nullptr);
+						std::cout << "Occlusion culling " << (occlusion ? "on" : "off") << "\n";
+						break;
+					//Load a level where most tiles are hidden behind a wall of big tiles
+					case SDLK_l:
+					{
+						std::vector<std::pair<size_t, std::tuple<UNorm8x4, GridTransform, uint32_t>>> level;
+						const uint16_t wall = GridTransform::orientation(glm::mat3{glm::rotate(util::deg_to_rad(90),
+							glm::vec3{1, 0, 0})});
+						for (int x = -20; x <= 20; x += 4){
+							for (int y = 0; y < 12; y += 4){
+								level.push_back({2, std::make_tuple(UNorm8x4{glm::vec3{0.5f, 0.5f, 0.5f}},
+									GridTransform{glm::ivec3{x, y, -5}, wall}, BRICK)});
+							}
+						}
+						for (int x = -20; x < 20; x += 2){
+							for (int y = 0; y < 10; y += 2){
+								for (int z = -8; z > -48; z -= 2){
+									level.push_back({static_cast<size_t>(((x + y + z) / 2) & 1),
+										std::make_tuple(UNorm8x4{glm::vec3{0.f, 0.5f, 1.f}},
+										GridTransform{glm::ivec3{x, y, z}}, static_cast<uint32_t>((x / 2 + z) & 3))});
+								}
+							}
+						}
+						tile_batches.push_instances(level);
+						if (depth_sort){
+							tile_batches.sort_front_to_back<1>(view);
+						}
+						std::cout << "Loaded " << level.size() << " occlusion test tiles\n";
+						break;
+					}
+					//Compare the triangles in the batch with those which made it through culling
+					case SDLK_i:
+					{
+						size_t submitted = 0;
+						for (size_t m = 0; m < num_elems.size(); ++m){
+							submitted += tile_batches.instance_count(m) * num_elems[m] / 3;
+						}
+						std::cout << "Triangles submitted: " << submitted << ", drawn: " << prims_drawn << "\n";
+						if (occlusion && tile_batches.cull_mode() == CullMode::GPU){
+							std::cout << "Occluder triangles drawn into the depth pyramid: " << occluder_prims_drawn << "\n";
+						}
+						if (pipeline_stats){
+							std::cout << "Fragments shaded: " << frags_shaded << "\n";
+						}
+						const RenderStats &stats = render_queue.last_stats();
+						std::cout << "Draws: " << stats.draws << ", program changes: " << stats.program_changes
+							<< ", VAO changes: " << stats.vao_changes << ", texture changes: "
+							<< stats.texture_changes << "\n";
+						break;
+					}
+					//Switch between reading the instances from attributes and from a storage buffer
+					case SDLK_v:
+						if (tile_batches.instance_fetch() == InstanceFetch::STORAGE){
+							tile_batches.set_instance_fetch(InstanceFetch::ATTRIBUTES);
+							std::cout << "Instances read from attributes\n";
+						}
+						else if (storage_shader && tile_batches.set_instance_fetch(InstanceFetch::STORAGE, 0)){
+							std::cout << "Instances read from a storage buffer\n";
+						}
+						else {
+							std::cout << "ARB_shader_draw_parameters is unavailable\n";
+						}
+						break;
+					//Toggle sorting the instances front to back whenever the view changes. The order
+					//only reaches the draw with CPU or no culling, GPU culling compacts out of order
+					case SDLK_f:
+						depth_sort = !depth_sort;
+						if (depth_sort){
+							tile_batches.sort_front_to_back<1>(view);
+						}
+						std::cout << "Front to back sorting " << (depth_sort ? "on" : "off") << "\n";
+						if (tile_batches.cull_mode() == CullMode::GPU){
+							std::cout << "GPU culling doesn't keep the sorted order, switch to CPU or no culling"
+								<< " to see its effect\n";
+						}
+						break;
 					case SDLK_ESCAPE:
 						quit = true;
 						break;
@@ -145,18 +338,81 @@ int main(int, char**){
 					eye_pos = glm::vec3{0, 4, 8};
 					break;
 			}
+			view = glm::lookAt(eye_pos, glm::vec3{0.f, 0.f, 0.f}, glm::vec3{0.f, 1.f, 0.f});
+			if (depth_sort){
+				tile_batches.sort_front_to_back<1>(view);
+			}
 			viewing.map(GL_WRITE_ONLY);
-			viewing.write<0>(0) = glm::lookAt(eye_pos, glm::vec3{0.f, 0.f, 0.f},
-				glm::vec3{0.f, 1.f, 0.f});
+			viewing.write<0>(0) = view;
 			viewing.unmap();
 		}
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		tile_batches.render();
+		if (occlusion && tile_batches.cull_mode() == CullMode::CPU){
+			software_occlusion.begin(proj * view);
+			tile_batches.add_occluders<1>(software_occlusion, big_tile_model, big_tile_proxy);
+			software_occlusion.rasterize(cull_pool);
+		}
+		if (tile_batches.cull_mode() != CullMode::NONE){
+			tile_batches.cull(Frustum{proj * view});
+		}
+		if (prims_pending){
+			prims_pending = !read_query(prims_query, prims_drawn);
+		}
+		const bool count_prims = !prims_pending;
+		if (count_prims){
+			glBeginQuery(GL_PRIMITIVES_GENERATED, prims_query);
+		}
+		if (frags_pending){
+			frags_pending = !read_query(frags_query, frags_shaded);
+		}
+		const bool count_frags = pipeline_stats && !frags_pending;
+		if (count_frags){
+			glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, frags_query);
+		}
+		tile_batches.submit(render_queue, 0, tile_batches.instance_fetch() == InstanceFetch::STORAGE ? storage_shader
+			: shader, tile_texture_binding);
+		render_queue.flush();
+		if (count_frags){
+			glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+			frags_pending = true;
+		}
+		if (count_prims){
+			glEndQuery(GL_PRIMITIVES_GENERATED);
+			prims_pending = true;
+		}
+		if (occlusion && tile_batches.cull_mode() == CullMode::GPU){
+			if (occluder_pending){
+				occluder_pending = !read_query(occluder_query, occluder_prims_drawn);
+			}
+			const bool count_occluders = !occluder_pending;
+			pyramid.begin(proj * view);
+			if (count_occluders){
+				glBeginQuery(GL_PRIMITIVES_GENERATED, occluder_query);
+			}
+			tile_batches.render_model(big_tile_model);
+			if (count_occluders){
+				glEndQuery(GL_PRIMITIVES_GENERATED);
+				occluder_pending = true;
+			}
+			pyramid.end();
+		}
 
 		SDL_GL_SwapWindow(win);
 	}
 	glDeleteProgram(shader);
+	if (storage_shader){
+		glDeleteProgram(storage_shader);
+	}
+	util::delete_texture(tile_textures);
+	glDeleteProgram(cull_shader);
+	glDeleteProgram(compact_shader);
+	glDeleteProgram(pyramid_shader);
+	glDeleteQueries(1, &prims_query);
+	glDeleteQueries(1, &occluder_query);
+	if (pipeline_stats){
+		glDeleteQueries(1, &frags_query);
+	}
 
 	SDL_GL_DeleteContext(context);
 	SDL_DestroyWindow(win);
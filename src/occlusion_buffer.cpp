@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "frustum.h"
+#include "cpu_cull.h"
+#include "thread_pool.h"
+#include "occlusion_buffer.h"
+#include "simd.h"
+
+//Rows of the buffer rasterized by each job
+const int STRIP_ROWS = 16;
+
+OccluderMesh OccluderMesh::box(const AABB &box){
+	OccluderMesh mesh;
+	for (int i = 0; i < 8; ++i){
+		mesh.verts.push_back(glm::vec3{i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y,
+			i & 4 ? box.max.z : box.min.z});
+	}
+	//The winding doesn't matter as the rasterizer draws both faces
+	mesh.indices = {0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1,
+		2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3};
+	return mesh;
+}
+
+OcclusionBuffer::OcclusionBuffer(size_t width, size_t height)
+	: buf_width(width), buf_height(height), stride((width + 3) & ~size_t{3}), depth_buf(stride * height, 1.f)
+{}
+void OcclusionBuffer::begin(const glm::mat4 &view_proj){
+	occluder_view_proj = view_proj;
+	std::fill(depth_buf.begin(), depth_buf.end(), 1.f);
+	triangles.clear();
+}
+void OcclusionBuffer::add_occluder(const OccluderMesh &mesh, const glm::mat4 &transform){
+	const glm::mat4 mvp = occluder_view_proj * transform;
+	std::vector<glm::vec3> screen(mesh.verts.size());
+	std::vector<bool> clipped(mesh.verts.size());
+	for (size_t i = 0; i < mesh.verts.size(); ++i){
+		const glm::vec4 p = mvp * glm::vec4{mesh.verts[i], 1.f};
+		clipped[i] = p.w <= 1e-5f || p.z < -p.w;
+		if (!clipped[i]){
+			screen[i] = glm::vec3{(p.x / p.w * 0.5f + 0.5f) * buf_width, (p.y / p.w * 0.5f + 0.5f) * buf_height,
+				p.z / p.w * 0.5f + 0.5f};
+		}
+	}
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3){
+		const uint32_t *idx = &mesh.indices[i];
+		if (clipped[idx[0]] || clipped[idx[1]] || clipped[idx[2]]){
+			continue;
+		}
+		glm::vec3 v[3] = {screen[idx[0]], screen[idx[1]], screen[idx[2]]};
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+		if (std::abs(area) < 1e-6f){
+			continue;
+		}
+		//Make the triangle counter clockwise so the edge functions are positive inside
+		if (area < 0){
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+		Triangle t;
+		t.x0 = std::max(static_cast<int>(std::floor(std::min({v[0].x, v[1].x, v[2].x}))), 0);
+		t.y0 = std::max(static_cast<int>(std::floor(std::min({v[0].y, v[1].y, v[2].y}))), 0);
+		t.x1 = std::min(static_cast<int>(std::ceil(std::max({v[0].x, v[1].x, v[2].x}))), static_cast<int>(buf_width) - 1);
+		t.y1 = std::min(static_cast<int>(std::ceil(std::max({v[0].y, v[1].y, v[2].y}))), static_cast<int>(buf_height) - 1);
+		if (t.x0 > t.x1 || t.y0 > t.y1){
+			continue;
+		}
+		//Edge e is opposite vertex e so its value over the area is vertex e's barycentric weight
+		for (int e = 0; e < 3; ++e){
+			const glm::vec3 &a = v[(e + 1) % 3];
+			const glm::vec3 &b = v[(e + 2) % 3];
+			t.ea[e] = a.y - b.y;
+			t.eb[e] = b.x - a.x;
+			t.ec[e] = -t.ea[e] * a.x - t.eb[e] * a.y;
+		}
+		t.za = (t.ea[0] * v[0].z + t.ea[1] * v[1].z + t.ea[2] * v[2].z) / area;
+		t.zb = (t.eb[0] * v[0].z + t.eb[1] * v[1].z + t.eb[2] * v[2].z) / area;
+		t.zc = (t.ec[0] * v[0].z + t.ec[1] * v[1].z + t.ec[2] * v[2].z) / area;
+		triangles.push_back(t);
+	}
+}
+void OcclusionBuffer::rasterize(ThreadPool &pool){
+	const int rows = static_cast<int>(buf_height);
+	pool.run((rows + STRIP_ROWS - 1) / STRIP_ROWS, [&](size_t s){
+		const int begin = static_cast<int>(s) * STRIP_ROWS;
+		rasterize_rows(begin, std::min(begin + STRIP_ROWS, rows));
+	});
+}
+bool OcclusionBuffer::visible(const AABB &box) const {
+	return visible(box.center(), box.extent());
+}
+size_t OcclusionBuffer::test_bounds(const BoundsSoA &bounds, const uint32_t *indices, size_t count,
+	uint32_t *visible_out) const
+{
+	size_t n_visible = 0;
+	for (size_t i = 0; i < count; ++i){
+		const uint32_t b = indices[i];
+		if (visible(glm::vec3{bounds.cx[b], bounds.cy[b], bounds.cz[b]}, glm::vec3{bounds.ex[b], bounds.ey[b], bounds.ez[b]})){
+			visible_out[n_visible++] = b;
+		}
+	}
+	return n_visible;
+}
+size_t OcclusionBuffer::width() const {
+	return buf_width;
+}
+size_t OcclusionBuffer::height() const {
+	return buf_height;
+}
+float OcclusionBuffer::depth(size_t x, size_t y) const {
+	return depth_buf[y * stride + x];
+}
+size_t OcclusionBuffer::occluder_triangles() const {
+	return triangles.size();
+}
+void OcclusionBuffer::rasterize_rows(int row_begin, int row_end){
+	for (const auto &t : triangles){
+		const int y0 = std::max(t.y0, row_begin);
+		const int y1 = std::min(t.y1, row_end - 1);
+		if (y0 > y1){
+			continue;
+		}
+		//Start on a multiple of 4 so groups of pixels never run past the padded row, the pixels
+		//outside the triangle's bounds are outside the triangle and left alone
+		const int x0 = t.x0 & ~3;
+		for (int y = y0; y <= y1; ++y){
+			float *row = &depth_buf[y * stride];
+			const float py = y + 0.5f;
+			int x = x0;
+#ifdef HAS_SSE
+			const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			const __m128 zero = _mm_setzero_ps();
+			__m128 e[3], step[3];
+			for (int i = 0; i < 3; ++i){
+				const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane);
+				e[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.ea[i]), px), _mm_set1_ps(t.eb[i] * py + t.ec[i]));
+				step[i] = _mm_set1_ps(4 * t.ea[i]);
+			}
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.za), _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane)),
+				_mm_set1_ps(t.zb * py + t.zc));
+			const __m128 z_step = _mm_set1_ps(4 * t.za);
+			for (; x <= t.x1; x += 4){
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)),
+					_mm_cmpge_ps(e[2], zero));
+				if (_mm_movemask_ps(inside)){
+					const __m128 old = _mm_loadu_ps(row + x);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, z)), _mm_andnot_ps(inside, old)));
+				}
+				for (int i = 0; i < 3; ++i){
+					e[i] = _mm_add_ps(e[i], step[i]);
+				}
+				z = _mm_add_ps(z, z_step);
+			}
+#endif
+			for (; x <= t.x1; ++x){
+				const float px = x + 0.5f;
+				bool inside = true;
+				for (int i = 0; i < 3; ++i){
+					inside = inside && t.ea[i] * px + t.eb[i] * py + t.ec[i] >= 0;
+				}
+				if (inside){
+					row[x] = std::min(row[x], t.za * px + t.zb * py + t.zc);
+				}
+			}
+		}
+	}
+}
+bool OcclusionBuffer::visible(const glm::vec3 &center, const glm::vec3 &extent) const {
+	//Project the center and the box's axes once and build the corners from them in clip space
+	const glm::vec4 c = occluder_view_proj * glm::vec4{center, 1.f};
+	const glm::vec4 ax = occluder_view_proj[0] * extent.x;
+	const glm::vec4 ay = occluder_view_proj[1] * extent.y;
+	const glm::vec4 az = occluder_view_proj[2] * extent.z;
+	glm::vec3 ndc_min{1.f}, ndc_max{-1.f};
+	for (int i = 0; i < 8; ++i){
+		const glm::vec4 p = c + (i & 1 ? ax : -ax) + (i & 2 ? ay : -ay) + (i & 4 ? az : -az);
+		//Boxes crossing the near plane can't be projected, just treat them as visible
+		if (p.w <= 1e-5f || p.z < -p.w){
+			return true;
+		}
+		const glm::vec3 ndc = glm::vec3{p.x, p.y, p.z} / p.w;
+		ndc_min = glm::min(ndc_min, ndc);
+		ndc_max = glm::max(ndc_max, ndc);
+	}
+	const int x0 = std::max(static_cast<int>(std::floor((ndc_min.x * 0.5f + 0.5f) * buf_width)), 0);
+	const int y0 = std::max(static_cast<int>(std::floor((ndc_min.y * 0.5f + 0.5f) * buf_height)), 0);
+	const int x1 = std::min(static_cast<int>(std::floor((ndc_max.x * 0.5f + 0.5f) * buf_width)), static_cast<int>(buf_width) - 1);
+	const int y1 = std::min(static_cast<int>(std::floor((ndc_max.y * 0.5f + 0.5f) * buf_height)), static_cast<int>(buf_height) - 1);
+	//Off screen boxes are left to frustum culling
+	if (x0 > x1 || y0 > y1){
+		return true;
+	}
+	//The box is hidden if its nearest point is behind the occluders at every pixel it covers
+	const float box_depth = ndc_min.z * 0.5f + 0.5f;
+	for (int y = y0; y <= y1; ++y){
+		const float *row = &depth_buf[y * stride];
+		int x = x0;
+#ifdef HAS_SSE
+		const __m128 bd = _mm_set1_ps(box_depth);
+		for (; x + 3 <= x1; x += 4){
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), bd))){
+				return true;
+			}
+		}
+#endif
+		for (; x <= x1; ++x){
+			if (row[x] >= box_depth){
+				return true;
+			}
+		}
+	}
+	return false;
+}
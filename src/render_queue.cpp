@@ -0,0 +1,77 @@
+#include <cassert>
+#include <algorithm>
+#include <utility>
+#include "gl_core_4_4.h"
+#include "radix_sort.h"
+#include "render_queue.h"
+
+constexpr int RenderQueue::PASS_BITS;
+constexpr int RenderQueue::STATE_BITS;
+constexpr int RenderQueue::DEPTH_BITS;
+
+void RenderQueue::submit(DrawPacket packet){
+	assert(packet.pass < (1u << PASS_BITS));
+	const uint64_t depth = static_cast<uint64_t>(std::min(std::max(packet.depth, 0.f), 1.f)
+		* ((1u << DEPTH_BITS) - 1));
+	const uint64_t key = static_cast<uint64_t>(packet.pass) << (3 * STATE_BITS + DEPTH_BITS)
+		| static_cast<uint64_t>(state_id(program_ids, packet.program)) << (2 * STATE_BITS + DEPTH_BITS)
+		| static_cast<uint64_t>(state_id(vao_ids, packet.vao)) << (STATE_BITS + DEPTH_BITS)
+		| static_cast<uint64_t>(state_id(texture_ids, packet.texture.texture)) << DEPTH_BITS
+		| depth;
+	keys.push_back(key);
+	order.push_back(static_cast<uint32_t>(packets.size()));
+	packets.push_back(std::move(packet));
+}
+void RenderQueue::flush(){
+	util::radix_sort(keys, order);
+	stats = RenderStats{};
+	//Nothing is known to be bound at the start so the first packet sets everything
+	bool first = true;
+	GLuint program = 0, vao = 0;
+	TextureBinding texture;
+	for (const auto i : order){
+		const DrawPacket &p = packets[i];
+		if (first || p.program != program){
+			glUseProgram(p.program);
+			program = p.program;
+			++stats.program_changes;
+		}
+		if (first || p.vao != vao){
+			glBindVertexArray(p.vao);
+			vao = p.vao;
+			++stats.vao_changes;
+		}
+		if (p.texture.texture != 0 && (first || p.texture.texture != texture.texture
+			|| p.texture.unit != texture.unit || p.texture.target != texture.target))
+		{
+			glActiveTexture(GL_TEXTURE0 + p.texture.unit);
+			glBindTexture(p.texture.target, p.texture.texture);
+			texture = p.texture;
+			++stats.texture_changes;
+		}
+		first = false;
+		p.draw();
+		++stats.draws;
+	}
+	packets.clear();
+	keys.clear();
+	order.clear();
+	//Ids only need to be stable within a frame's sort
+	program_ids.clear();
+	vao_ids.clear();
+	texture_ids.clear();
+}
+size_t RenderQueue::size() const {
+	return packets.size();
+}
+const RenderStats& RenderQueue::last_stats() const {
+	return stats;
+}
+uint32_t RenderQueue::state_id(std::unordered_map<GLuint, uint32_t> &ids, GLuint name){
+	auto it = ids.find(name);
+	if (it == ids.end()){
+		assert(ids.size() < (1u << STATE_BITS));
+		it = ids.emplace(name, static_cast<uint32_t>(ids.size())).first;
+	}
+	return it->second;
+}
@@ -0,0 +1,104 @@
+#include <cassert>
+#include <algorithm>
+#include "gl_core_4_4.h"
+#include "gl_caps.h"
+#include "gpu_memory.h"
+#include "staging_pool.h"
+
+StagingPool::StagingPool(size_t min_size) : min_size(min_size){}
+StagingPool::~StagingPool(){
+	for (auto &s : buffers){
+		if (s.fence){
+			glDeleteSync(s.fence);
+		}
+		if (util::has_dsa()){
+			glUnmapNamedBuffer(s.buffer);
+		}
+		else {
+			glBindBuffer(GL_COPY_READ_BUFFER, s.buffer);
+			glUnmapBuffer(GL_COPY_READ_BUFFER);
+		}
+		glDeleteBuffers(1, &s.buffer);
+		gpu_memory::track_free(MemCategory::STAGING, s.size);
+	}
+}
+StagingBlock StagingPool::acquire(size_t size){
+	//Find the smallest free staging buffer that can fit the block
+	Staging *best = nullptr;
+	size_t best_index = 0;
+	for (size_t i = 0; i < buffers.size(); ++i){
+		Staging &s = buffers[i];
+		if (s.size >= size && (!s.in_use || try_recycle(s)) && (!best || s.size < best->size)){
+			best = &s;
+			best_index = i;
+		}
+	}
+	if (!best){
+		Staging s;
+		s.size = std::max(size, min_size);
+		s.fence = 0;
+		s.in_use = false;
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		if (util::has_dsa()){
+			glCreateBuffers(1, &s.buffer);
+			glNamedBufferStorage(s.buffer, s.size, NULL, flags);
+			s.ptr = static_cast<char*>(glMapNamedBufferRange(s.buffer, 0, s.size, flags));
+		}
+		else {
+			glGenBuffers(1, &s.buffer);
+			glBindBuffer(GL_COPY_READ_BUFFER, s.buffer);
+			glBufferStorage(GL_COPY_READ_BUFFER, s.size, NULL, flags);
+			s.ptr = static_cast<char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, s.size, flags));
+		}
+		gpu_memory::track_alloc(MemCategory::STAGING, s.size);
+		buffers.push_back(s);
+		best = &buffers.back();
+		best_index = buffers.size() - 1;
+	}
+	best->in_use = true;
+	StagingBlock block;
+	block.buffer = best->buffer;
+	block.size = best->size;
+	block.index = best_index;
+	block.ptr = best->ptr;
+	return block;
+}
+void StagingPool::submit(const StagingBlock &block, GLuint dst, size_t dst_offset, size_t bytes){
+	assert(block.index < buffers.size() && buffers[block.index].buffer == block.buffer);
+	assert(bytes <= block.size);
+	Staging &s = buffers[block.index];
+	if (bytes > 0){
+		if (util::has_dsa()){
+			glCopyNamedBufferSubData(s.buffer, dst, 0, dst_offset, bytes);
+		}
+		else {
+			glBindBuffer(GL_COPY_READ_BUFFER, s.buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, dst_offset, bytes);
+		}
+	}
+	s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+size_t StagingPool::buffer_count() const {
+	return buffers.size();
+}
+size_t StagingPool::pending() const {
+	return std::count_if(buffers.begin(), buffers.end(),
+		[](const Staging &s){
+			return s.in_use;
+		});
+}
+bool StagingPool::try_recycle(Staging &s){
+	//A block that was acquired but not submitted yet is still being written
+	if (!s.fence){
+		return false;
+	}
+	GLenum status = glClientWaitSync(s.fence, 0, 0);
+	if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED){
+		glDeleteSync(s.fence);
+		s.fence = 0;
+		s.in_use = false;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads)
+	: job(nullptr), job_count(0), generation(0), finished(0), next_job(0), quit(false)
+{
+	if (threads == 0){
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	for (size_t i = 1; i < threads; ++i){
+		workers.emplace_back(&ThreadPool::worker_loop, this);
+	}
+}
+ThreadPool::~ThreadPool(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	work_cv.notify_all();
+	for (auto &w : workers){
+		w.join();
+	}
+}
+size_t ThreadPool::size() const {
+	return workers.size() + 1;
+}
+void ThreadPool::run(size_t count, const std::function<void(size_t)> &f){
+	if (workers.empty() || count <= 1){
+		for (size_t i = 0; i < count; ++i){
+			f(i);
+		}
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job = &f;
+		job_count = count;
+		next_job = 0;
+		finished = 0;
+		++generation;
+	}
+	work_cv.notify_all();
+	work(f, count);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done_cv.wait(lock, [&](){ return finished == workers.size(); });
+	job = nullptr;
+}
+void ThreadPool::worker_loop(){
+	size_t seen = 0;
+	while (true){
+		const std::function<void(size_t)> *f = nullptr;
+		size_t count = 0;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			work_cv.wait(lock, [&](){ return quit || generation != seen; });
+			if (quit){
+				return;
+			}
+			seen = generation;
+			f = job;
+			count = job_count;
+		}
+		work(*f, count);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++finished;
+		}
+		done_cv.notify_one();
+	}
+}
+void ThreadPool::work(const std::function<void(size_t)> &f, size_t count){
+	for (size_t i = next_job++; i < count; i = next_job++){
+		f(i);
+	}
+}
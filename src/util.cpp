@@ -7,11 +7,13 @@
 #include <fstream>
 #include <string>
 #include <tuple>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <SDL.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "gl_core_4_4.h"
+#include "gpu_memory.h"
 #include "util.h"
 
 std::string util::get_resource_path(const std::string &sub_dir){
@@ -65,6 +67,9 @@ GLint util::load_shader(GLenum type, const std::string &file){
 		case GL_GEOMETRY_SHADER:
 			std::cerr << "Geometry shader: ";
 			break;
+		case GL_COMPUTE_SHADER:
+			std::cerr << "Compute shader: ";
+			break;
 		default:
 			std::cerr << "Other shader type: ";
 		}
@@ -80,9 +85,24 @@ GLint util::load_shader(GLenum type, const std::string &file){
 	}
 	return shader;
 }
-GLint util::load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders){
-	std::vector<GLuint> glshaders;
+GLint util::load_program(const std::vector<std::tuple<GLenum, std::string>> &shaders,
+	const std::vector<std::string> &shared)
+{
+	//Each stage gets its own copy of the shared files
+	std::vector<std::tuple<GLenum, std::string>> sources = shaders;
+	std::vector<GLenum> stages;
 	for (const auto &s : shaders){
+		if (std::find(stages.begin(), stages.end(), std::get<0>(s)) == stages.end()){
+			stages.push_back(std::get<0>(s));
+		}
+	}
+	for (GLenum stage : stages){
+		for (const auto &f : shared){
+			sources.push_back(std::make_tuple(stage, f));
+		}
+	}
+	std::vector<GLuint> glshaders;
+	for (const auto &s : sources){
 		GLint h = load_shader(std::get<0>(s), std::get<1>(s));
 		if (h == -1){
 			std::cerr << "load_program: A required shader failed to compile, aborting\n";
@@ -126,6 +146,20 @@ void swap_row(unsigned char *a, unsigned char *b, size_t n){
 		std::swap(a[i], b[i]);
 	}
 }
+//Estimate the bytes used by a w x h texture with layers layers of n byte texels
+//and a full mip chain, the driver may pad texels (e.g. RGB to RGBA) so this is a lower bound
+size_t texture_bytes(size_t w, size_t h, size_t layers, size_t n){
+	size_t bytes = 0;
+	while (true){
+		bytes += w * h * layers * n;
+		if (w == 1 && h == 1){
+			break;
+		}
+		w = std::max(w / 2, size_t{1});
+		h = std::max(h / 2, size_t{1});
+	}
+	return bytes;
+}
 GLuint util::load_texture(const std::string &file, size_t *width, size_t *height){
 	int x, y, n;
 	unsigned char *img = stbi_load(file.c_str(), &x, &y, &n, 0);
@@ -165,6 +199,7 @@ GLuint util::load_texture(const std::string &file, size_t *width, size_t *height
 	glTexImage2D(GL_TEXTURE_2D, 0, format, x, y, 0, format, GL_UNSIGNED_BYTE, img);
 	glGenerateMipmap(GL_TEXTURE_2D);
 	stbi_image_free(img);
+	gpu_memory::track_texture(tex, texture_bytes(x, y, 1, n));
 	return tex;
 }
 GLuint util::load_texture_array(const std::vector<std::string> &files, size_t *w, size_t *h){
@@ -225,8 +260,13 @@ GLuint util::load_texture_array(const std::vector<std::string> &files, size_t *w
 	for (auto i : images){
 		stbi_image_free(i);
 	}
+	gpu_memory::track_texture(tex, texture_bytes(x, y, images.size(), n));
 	return tex;
 }
+void util::delete_texture(GLuint tex){
+	gpu_memory::release_texture(tex);
+	glDeleteTextures(1, &tex);
+}
 bool util::log_glerror(const std::string &msg){
 	GLenum err = glGetError();
 	if (err != GL_NO_ERROR){
@@ -323,7 +363,8 @@ void util::gldebug_callback(GLenum src, GLenum type, GLuint, GLenum severity,
 	std::cerr << "\n\tMessage: " << msg << "\n";
 }
 bool util::load_obj(const std::string &fname, PackedBuffer<glm::vec3, glm::vec3, glm::vec3> &vbo,
-	PackedBuffer<GLushort> &ebo, size_t &n_elems, size_t *n_verts, size_t vert_offset, size_t elem_offset)
+	PackedBuffer<GLushort> &ebo, size_t &n_elems, size_t *n_verts, size_t vert_offset, size_t elem_offset,
+	StagingPool *staging, AABB *bounds)
 {
 	std::ifstream file(fname);
 	if (!file.is_open()){
@@ -388,7 +429,12 @@ bool util::load_obj(const std::string &fname, PackedBuffer<glm::vec3, glm::vec3,
 		}
 	}
 	vbo.reserve(vert_data.size() / 3 + vert_offset);
-	vbo.map(GL_WRITE_ONLY);
+	if (staging){
+		vbo.map_staged(*staging, vert_offset, vert_data.size() / 3);
+	}
+	else {
+		vbo.map(GL_WRITE_ONLY);
+	}
 	for (size_t i = 0; i < vert_data.size() / 3; ++i){
 		vbo.write<0>(i + vert_offset) = vert_data[3 * i];
 		vbo.write<1>(i + vert_offset) = vert_data[3 * i + 1];
@@ -398,10 +444,21 @@ bool util::load_obj(const std::string &fname, PackedBuffer<glm::vec3, glm::vec3,
 	if (n_verts){
 		*n_verts = vert_data.size() / 3;
 	}
+	if (bounds){
+		*bounds = AABB{};
+		for (size_t i = 0; i < vert_data.size(); i += 3){
+			bounds->expand(vert_data[i]);
+		}
+	}
 
 	n_elems = indices.size();
 	ebo.reserve(n_elems + elem_offset);
-	ebo.map(GL_WRITE_ONLY);
+	if (staging){
+		ebo.map_staged(*staging, elem_offset, n_elems);
+	}
+	else {
+		ebo.map(GL_WRITE_ONLY);
+	}
 	for (size_t i = 0; i < indices.size(); ++i){
 		ebo.write<0>(i + elem_offset) = indices[i] + vert_offset;
 	}